@@ -3,3 +3,6 @@
 cd src/shaders
 glslc simple_shader.vert -o simple_shader.vert.spv
 glslc simple_shader.frag -o simple_shader.frag.spv
+glslc depth_prepass.vert -o depth_prepass.vert.spv
+glslc hiz_downsample.comp -o hiz_downsample.comp.spv
+glslc mip_downsample.comp -o mip_downsample.comp.spv
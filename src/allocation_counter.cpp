@@ -0,0 +1,91 @@
+#include "allocation_counter.h"
+
+// std lib headers
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace lve {
+
+static std::atomic<uint64_t> allocationCount{0};
+
+uint64_t getHeapAllocationCount() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+static void *allocate(std::size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+static void *allocateAligned(std::size_t size, std::align_val_t alignment) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  auto align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a nonzero multiple of the alignment
+  size = std::max(size, align);
+  return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+}  // namespace lve
+
+// Replacements of the global allocation functions, which count every
+// allocation. The remaining overloads forward to these.
+
+void *operator new(std::size_t size) {
+  void *pointer = lve::allocate(size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc{};
+  }
+  return pointer;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return lve::allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return lve::allocate(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  void *pointer = lve::allocateAligned(size, alignment);
+  if (pointer == nullptr) {
+    throw std::bad_alloc{};
+  }
+  return pointer;
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept {
+  std::free(pointer);
+}
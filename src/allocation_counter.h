@@ -0,0 +1,14 @@
+#pragma once
+
+// std lib headers
+#include <cstdint>
+
+namespace lve {
+
+// Heap allocations made through the global operator new, on every thread,
+// since startup; steady-state frames are meant to make none. Allocations by C
+// libraries calling malloc directly, such as GLFW or the Vulkan loader, are
+// not counted.
+uint64_t getHeapAllocationCount();
+
+}  // namespace lve
@@ -1,16 +1,53 @@
 #include "app.h"
 
+#include "allocation_counter.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
 namespace lve {
 
+struct SimplePushConstantData {
+  glm::vec2 positionScale;
+  glm::vec2 positionOffset;
+};
+
+// constant_ids of simple_shader.frag
+struct SimpleShaderConstants {
+  VkBool32 encodeSrgb;
+};
+
 App::App() {
+  reactiveRendering = std::getenv("LVE_REACTIVE") != nullptr;
+  recordEveryFrame = std::getenv("LVE_RECORD_EVERY_FRAME") != nullptr;
+  windowExtent = window.getExtent();
+  if (device.supportsDescriptorIndexing()) {
+    bindless = std::make_unique<BindlessResources>(device);
+    LogMessage{LogSeverity::Info}
+        << "Bindless: " << bindless->getTextureCapacity() << " texture and "
+        << bindless->getBufferCapacity() << " buffer slots";
+  }
+  // created on first use, but reloaded once it exists
+  useShader(MipmapGenerator::DOWNSAMPLE_SHADER_PATH, MIP_DOWNSAMPLE_PIPELINE);
   loadModels();
   createPipelineLayout();
   recreateSwapChain();
   createCommandBuffers();
+
+  scene.positionScale = model->getPositionScale();
+  scene.positionOffset = model->getPositionOffset();
+  nextSnapshot.previous = scene;
+  nextSnapshot.current = scene;
+  nextSnapshot.reactiveRendering = reactiveRendering;
 }
 
 App::~App() {
-  vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+  vkDestroyPipelineLayout(device.device(), pipelineLayout, device.allocator());
 }
 
 void App::loadModels() {
@@ -23,59 +60,278 @@ void App::loadModels() {
 }
 
 void App::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(SimplePushConstantData);
+
+  VkDescriptorSetLayout bindlessSetLayout = VK_NULL_HANDLE;
+  if (bindless != nullptr) {
+    bindlessSetLayout = bindless->getDescriptorSetLayout();
+  }
+
   VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
   pipelineLayoutCreateInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutCreateInfo.setLayoutCount = 0;
-  pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-  pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-  pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+  pipelineLayoutCreateInfo.setLayoutCount = bindless != nullptr ? 1 : 0;
+  pipelineLayoutCreateInfo.pSetLayouts = &bindlessSetLayout;
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
   if (vkCreatePipelineLayout(device.device(),
                              &pipelineLayoutCreateInfo,
-                             nullptr,
+                             device.allocator(),
                              &pipelineLayout) != VK_SUCCESS) {
     throw std::runtime_error("failed to create pipeline layout!");
   }
 }
 
+static constexpr const char *SIMPLE_VERT_SHADER_PATH =
+    "src/shaders/simple_shader.vert.spv";
+static constexpr const char *SIMPLE_FRAG_SHADER_PATH =
+    "src/shaders/simple_shader.frag.spv";
+static constexpr const char *DEPTH_PREPASS_VERT_SHADER_PATH =
+    "src/shaders/depth_prepass.vert.spv";
+
 void App::createPipeline() {
+  useShader(SIMPLE_VERT_SHADER_PATH, FORWARD_PIPELINES);
+  useShader(SIMPLE_FRAG_SHADER_PATH, FORWARD_PIPELINES);
+  useShader(DEPTH_PREPASS_VERT_SHADER_PATH, FORWARD_PIPELINES);
+  installPipelines(buildPipelines(swapchain->getRenderPass(),
+                                  swapchain->getSwapChainImageFormat(),
+                                  swapchain->findDepthFormat()));
+}
+
+App::ForwardPipelines App::buildPipelines(VkRenderPass renderPass,
+                                          VkFormat colorFormat,
+                                          VkFormat depthFormat) {
+  SimpleShaderConstants constants{};
+  constants.encodeSrgb = colorFormat != VK_FORMAT_B8G8R8A8_SRGB &&
+                         colorFormat != VK_FORMAT_R8G8B8A8_SRGB &&
+                         colorFormat != VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+  SpecializationConstants<SimpleShaderConstants> fragSpecialization{constants};
+  fragSpecialization.map(0, &SimpleShaderConstants::encodeSrgb);
+
   PipelineConfigInfo pipelineConfig{};
   Pipeline::makeDefaultPipelineConfigInfo(pipelineConfig);
-  pipelineConfig.renderPass = swapchain->getRenderPass();
+  pipelineConfig.renderPass = renderPass;
+  pipelineConfig.subpass = SwapChain::COLOR_SUBPASS;
   pipelineConfig.pipelineLayout = pipelineLayout;
-  pipeline = std::make_unique<Pipeline>(device,
-                                        "src/shaders/simple_shader.vert.spv",
-                                        "src/shaders/simple_shader.frag.spv",
-                                        pipelineConfig);
+  pipelineConfig.colorAttachmentFormat = colorFormat;
+  pipelineConfig.depthAttachmentFormat = depthFormat;
+  pipelineConfig.useExtendedDynamicState = true;
+  pipelineConfig.fragSpecialization = fragSpecialization;
+
+  PipelineConfigInfo depthPrepassConfig{};
+  Pipeline::makeDepthPrepassPipelineConfigInfo(depthPrepassConfig);
+  depthPrepassConfig.renderPass = renderPass;
+  depthPrepassConfig.subpass = SwapChain::DEPTH_PREPASS_SUBPASS;
+  depthPrepassConfig.pipelineLayout = pipelineLayout;
+  depthPrepassConfig.colorAttachmentFormat = colorFormat;
+  depthPrepassConfig.depthAttachmentFormat = depthFormat;
+
+  PipelineConfigInfo depthEqualConfig{};
+  Pipeline::makeDepthEqualPipelineConfigInfo(depthEqualConfig);
+  depthEqualConfig.renderPass = renderPass;
+  depthEqualConfig.subpass = SwapChain::COLOR_SUBPASS;
+  depthEqualConfig.pipelineLayout = pipelineLayout;
+  depthEqualConfig.colorAttachmentFormat = colorFormat;
+  depthEqualConfig.depthAttachmentFormat = depthFormat;
+  depthEqualConfig.useExtendedDynamicState = true;
+  depthEqualConfig.fragSpecialization = fragSpecialization;
+
+  // the pipelines are compiled in parallel, as driver compiles dominate
+  JobSystem &jobSystem = device.getJobSystem();
+  JobCounter compiled;
+  ForwardPipelines pipelines;
+  pipelines.colorFormat = colorFormat;
+  pipelines.renderPass = renderPass;
+  jobSystem.schedule(
+      compiled,
+      [&] {
+        pipelines.pipeline = std::make_unique<Pipeline>(
+            device,
+            SIMPLE_VERT_SHADER_PATH,
+            SIMPLE_FRAG_SHADER_PATH,
+            pipelineConfig);
+      },
+      "forward pipeline");
+  jobSystem.schedule(
+      compiled,
+      [&] {
+        pipelines.depthPrepassPipeline = std::make_unique<Pipeline>(
+            device, DEPTH_PREPASS_VERT_SHADER_PATH, "", depthPrepassConfig);
+      },
+      "depth prepass pipeline");
+
+  // only the depth state differs, which the shared pipeline sets when drawing
+  uint32_t avoidedCount = 0;
+  if (pipelineConfig.useExtendedDynamicState &&
+      device.supportsExtendedDynamicState()) {
+    pipelines.depthEqualState = Pipeline::getDynamicState(depthEqualConfig);
+    avoidedCount++;
+  } else {
+    jobSystem.schedule(
+        compiled,
+        [&] {
+          pipelines.depthEqualPipeline = std::make_unique<Pipeline>(
+              device,
+              SIMPLE_VERT_SHADER_PATH,
+              SIMPLE_FRAG_SHADER_PATH,
+              depthEqualConfig);
+        },
+        "depth equal pipeline");
+  }
+  jobSystem.wait(compiled);
+
+  LogMessage{LogSeverity::Info}
+      << "Pipelines: " << 3 - avoidedCount << " created, " << avoidedCount
+      << " avoided with extended dynamic state";
+  return pipelines;
 }
 
-void App::recreateSwapChain() {
-  auto extent = window.getExtent();
+void App::installPipelines(ForwardPipelines pipelines) {
+  // the replaced pipelines retire through the deletion queue
+  pipeline = std::move(pipelines.pipeline);
+  depthPrepassPipeline = std::move(pipelines.depthPrepassPipeline);
+  depthEqualPipeline = std::move(pipelines.depthEqualPipeline);
+  depthEqualState = pipelines.depthEqualState;
+  pipelineColorFormat = pipelines.colorFormat;
+  pipelineRenderPass = pipelines.renderPass;
+  invalidateCommandBuffers();
+}
 
-  while (extent.width == 0 || extent.height == 0) {
-    extent = window.getExtent();
-    glfwWaitEvents();
-  }
+void App::useShader(const std::string &spirvPath, ShaderUser user) {
+  // "src/shaders/simple_shader.frag.spv" is compiled from "simple_shader.frag"
+  size_t nameBegin = spirvPath.find_last_of('/') + 1;
+  size_t nameEnd = spirvPath.size() - std::strlen(".spv");
+  shaderUsers[spirvPath.substr(nameBegin, nameEnd - nameBegin)] |= user;
+}
 
-  vkDeviceWaitIdle(device.device());
+void App::recreateSwapChain() {
+  VkExtent2D extent = windowExtent;
+  // the reload's jobs use the current render pass and culler
+  finishPipelineReload();
 
+  // The replacement takes over the frame slots of the current swapchain, and
+  // everything replaced below goes through the deletion queue, so frames
+  // still in flight finish undisturbed.
   if (swapchain == nullptr) {
     swapchain = std::make_unique<SwapChain>(device, extent);
   } else {
     swapchain =
         std::make_unique<SwapChain>(device, extent, std::move(swapchain));
-    if (swapchain->imageCount() != commandBuffers.size()) {
+    if (swapchain->imageCount() * SwapChain::MAX_FRAMES_IN_FLIGHT !=
+        commandBuffers.size()) {
       freeCommandBuffers();
       createCommandBuffers();
     }
   }
 
-  createPipeline();
+  culler = std::make_unique<OcclusionCuller>(
+      device, samplerCache, swapchain->getSwapChainExtent());
+  useShader(OcclusionCuller::DOWNSAMPLE_SHADER_PATH, HIZ_DOWNSAMPLE_PIPELINE);
+
+  // pipelines only depend on the attachment formats, or on the render pass,
+  // which is kept while the formats are unchanged
+  if (pipeline == nullptr ||
+      swapchain->getSwapChainImageFormat() != pipelineColorFormat ||
+      swapchain->getRenderPass() != pipelineRenderPass) {
+    createPipeline();
+  }
+  createRenderGraph();
+}
+
+void App::createRenderGraph() {
+  VkFormat depthFormat = swapchain->findDepthFormat();
+  VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+      depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+    depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+
+  auto graph = std::make_unique<RenderGraph>(device);
+  // cleared every frame, so their previous contents never matter
+  backbufferResource =
+      graph->importImage("backbuffer", VK_IMAGE_ASPECT_COLOR_BIT, true);
+  depthResource = graph->importImage("depth", depthAspect, true);
+  readbackResource = graph->importBuffer("hi-z readback");
+  RenderGraphResource pyramid = graph->createImage(
+      "hi-z pyramid", culler->getPyramidImageInfo(), VK_IMAGE_ASPECT_COLOR_BIT);
+
+  if (swapchain->usesDynamicRendering()) {
+    graph
+        ->addPass("depth prepass",
+                  [this](VkCommandBuffer commandBuffer) {
+                    recordDepthPrepass(commandBuffer);
+                  })
+        .use(depthResource, RenderGraphAccess::DepthAttachmentWrite);
+    graph
+        ->addPass("color",
+                  [this](VkCommandBuffer commandBuffer) {
+                    recordColorPass(commandBuffer);
+                  })
+        .use(backbufferResource, RenderGraphAccess::ColorAttachmentWrite)
+        .use(depthResource, RenderGraphAccess::DepthAttachmentWrite);
+  } else {
+    graph
+        ->addPass("forward",
+                  [this](VkCommandBuffer commandBuffer) {
+                    recordForwardPass(commandBuffer);
+                  })
+        .attachment(backbufferResource,
+                    RenderGraphAccess::ColorAttachmentWrite)
+        .attachment(depthResource, RenderGraphAccess::DepthAttachmentWrite);
+  }
+  graph
+      ->addPass("hi-z build",
+                [this](VkCommandBuffer commandBuffer) {
+                  culler->recordPyramidBuild(
+                      commandBuffer,
+                      recordFrameIndex,
+                      swapchain->getDepthImageView(recordFrameIndex));
+                })
+      .use(depthResource, RenderGraphAccess::ComputeDepthRead)
+      .use(pyramid, RenderGraphAccess::ComputeStorageWrite);
+  graph
+      ->addPass("hi-z readback",
+                [this](VkCommandBuffer commandBuffer) {
+                  culler->recordReadback(commandBuffer,
+                                         recordFrameIndex,
+                                         frameArena.getResource());
+                })
+      .use(pyramid, RenderGraphAccess::TransferRead)
+      .use(readbackResource, RenderGraphAccess::TransferWrite);
+
+  if (swapchain->usesDynamicRendering()) {
+    graph->markOutput(backbufferResource, RenderGraphAccess::Present);
+  } else {
+    graph->markOutput(backbufferResource);
+  }
+  // without culling nothing reads the readback, so both hi-z passes are culled
+  if (occlusionCullingEnabled) {
+    graph->markOutput(readbackResource, RenderGraphAccess::HostRead);
+  }
+  graph->compile();
+
+  culler->setPyramid(graph->getImage(pyramid));
+  renderGraph = std::move(graph);
+  invalidateCommandBuffers();
+
+  const auto &stats = renderGraph->getStatistics();
+  LogMessage{LogSeverity::Info}
+      << "Render graph: " << stats.passCount << " passes ("
+      << stats.culledPassCount << " culled), " << stats.barrierBatchCount
+      << " barrier batches (" << stats.imageBarrierCount << " image, "
+      << stats.bufferBarrierCount << " buffer), "
+      << stats.transientBytes / 1024 << " KiB transient, "
+      << stats.aliasedBytes / 1024 << " KiB saved by aliasing";
 }
 
 void App::createCommandBuffers() {
-  commandBuffers.resize(swapchain->imageCount());
+  commandBuffers.resize(swapchain->imageCount() *
+                        SwapChain::MAX_FRAMES_IN_FLIGHT);
+  recordedContents.assign(commandBuffers.size(), RecordedContent{});
   VkCommandBufferAllocateInfo allocateInfo{};
   allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -91,26 +347,84 @@ void App::createCommandBuffers() {
 }
 
 void App::freeCommandBuffers() {
-  vkFreeCommandBuffers(device.device(),
-                       device.getCommandPool(),
-                       static_cast<uint32_t>(commandBuffers.size()),
-                       commandBuffers.data());
+  // frames of the previous swapchain may still be executing them
+  device.getDeletionQueue().push([device = device.device(),
+                                  commandPool = device.getCommandPool(),
+                                  commandBuffers = commandBuffers] {
+    vkFreeCommandBuffers(device,
+                         commandPool,
+                         static_cast<uint32_t>(commandBuffers.size()),
+                         commandBuffers.data());
+  });
   commandBuffers.clear();
+  recordedContents.clear();
 }
 
-void App::recordCommandBuffer(int imageIndex) {
+void App::invalidateCommandBuffers() {
+  contentVersion++;
+  requestFrames();
+}
+
+VkCommandBuffer App::recordCommandBuffer(uint32_t imageIndex) {
+  recordFrameIndex = swapchain->getCurrentFrameIndex();
+  recordImageIndex = imageIndex;
+  culler->beginFrame(recordFrameIndex);
+
+  modelVisible = true;
+  if (occlusionCullingEnabled) {
+    OcclusionBounds bounds{};
+    bounds.min = scene.positionOffset - scene.positionScale;
+    bounds.max = scene.positionOffset + scene.positionScale;
+    bounds.nearestDepth = 0.0f;
+    modelVisible = culler->isVisible(0, bounds);
+  }
+
+  size_t bufferIndex = recordFrameIndex * swapchain->imageCount() + imageIndex;
+  VkCommandBuffer commandBuffer = commandBuffers[bufferIndex];
+  // the scene is static, so most frames resubmit what was recorded before
+  auto &recorded = recordedContents[bufferIndex];
+  if (!recordEveryFrame && recorded.version == contentVersion &&
+      recorded.modelVisible == modelVisible &&
+      recorded.scene.positionScale == scene.positionScale &&
+      recorded.scene.positionOffset == scene.positionOffset) {
+    return commandBuffer;
+  }
+
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-  if (vkBeginCommandBuffer(commandBuffers[imageIndex], &beginInfo) !=
-      VK_SUCCESS) {
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
     throw std::runtime_error("failed to begin recording command buffer");
   }
+  profiler.recordBegin(commandBuffer, recordFrameIndex);
+  if (bindless != nullptr) {
+    bindless->bind(
+        commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
+  }
+
+  renderGraph->bindImage(backbufferResource, swapchain->getImage(imageIndex));
+  renderGraph->bindImage(depthResource,
+                         swapchain->getDepthImage(recordFrameIndex));
+  renderGraph->bindBuffer(readbackResource,
+                          culler->getReadbackBuffer(recordFrameIndex));
+  renderGraph->execute(commandBuffer, frameArena.getResource());
+  profiler.recordEnd(commandBuffer, recordFrameIndex);
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer");
+  }
+  recorded.version = contentVersion;
+  recorded.modelVisible = modelVisible;
+  recorded.scene = scene;
+  return commandBuffer;
+}
 
+void App::recordForwardPass(VkCommandBuffer commandBuffer) {
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   renderPassInfo.renderPass = swapchain->getRenderPass();
-  renderPassInfo.framebuffer = swapchain->getFrameBuffer(imageIndex);
+  renderPassInfo.framebuffer =
+      swapchain->getFrameBuffer(recordFrameIndex, recordImageIndex);
   renderPassInfo.renderArea.offset = {0, 0};
   renderPassInfo.renderArea.extent = swapchain->getSwapChainExtent();
 
@@ -121,8 +435,69 @@ void App::recordCommandBuffer(int imageIndex) {
   renderPassInfo.pClearValues = clearValues.data();
 
   vkCmdBeginRenderPass(
-      commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+      commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  setViewportAndScissor(commandBuffer);
+  drawDepthPrepass(commandBuffer);
+  vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  drawColor(commandBuffer);
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+void App::recordDepthPrepass(VkCommandBuffer commandBuffer) {
+  VkRenderingAttachmentInfoKHR depthAttachment{};
+  depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  depthAttachment.imageView = swapchain->getDepthImageView(recordFrameIndex);
+  depthAttachment.imageLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  renderingInfo.renderArea = {{0, 0}, swapchain->getSwapChainExtent()};
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = 0;
+  renderingInfo.pDepthAttachment = &depthAttachment;
+
+  device.cmdBeginRendering(commandBuffer, renderingInfo);
+  setViewportAndScissor(commandBuffer);
+  drawDepthPrepass(commandBuffer);
+  device.cmdEndRendering(commandBuffer);
+}
 
+void App::recordColorPass(VkCommandBuffer commandBuffer) {
+  VkRenderingAttachmentInfoKHR colorAttachment{};
+  colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  colorAttachment.imageView = swapchain->getImageView(recordImageIndex);
+  colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.clearValue.color = {0.1f, 0.1f, 0.1f, 1.0f};
+
+  VkRenderingAttachmentInfoKHR depthAttachment{};
+  depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  depthAttachment.imageView = swapchain->getDepthImageView(recordFrameIndex);
+  depthAttachment.imageLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  renderingInfo.renderArea = {{0, 0}, swapchain->getSwapChainExtent()};
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachments = &colorAttachment;
+  renderingInfo.pDepthAttachment = &depthAttachment;
+
+  device.cmdBeginRendering(commandBuffer, renderingInfo);
+  setViewportAndScissor(commandBuffer);
+  drawColor(commandBuffer);
+  device.cmdEndRendering(commandBuffer);
+}
+
+void App::setViewportAndScissor(VkCommandBuffer commandBuffer) {
   VkViewport viewport{};
   viewport.x = 0.0f;
   viewport.y = 0.0f;
@@ -131,56 +506,435 @@ void App::recordCommandBuffer(int imageIndex) {
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
   VkRect2D sissor{{0, 0}, swapchain->getSwapChainExtent()};
-  vkCmdSetViewport(commandBuffers[imageIndex], 0, 1, &viewport);
-  vkCmdSetScissor(commandBuffers[imageIndex], 0, 1, &sissor);
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &sissor);
+}
+
+void App::drawDepthPrepass(VkCommandBuffer commandBuffer) {
+  if (!modelVisible || !depthPrepassEnabled) {
+    return;
+  }
+  depthPrepassPipeline->bind(commandBuffer);
+  pushModelConstants(commandBuffer);
+  model->bindPositions(commandBuffer);
+  model->draw(commandBuffer);
+}
+
+void App::drawColor(VkCommandBuffer commandBuffer) {
+  if (!modelVisible) {
+    return;
+  }
+  if (depthPrepassEnabled && depthEqualPipeline == nullptr) {
+    pipeline->bind(commandBuffer, depthEqualState);
+  } else if (depthPrepassEnabled) {
+    depthEqualPipeline->bind(commandBuffer);
+  } else {
+    pipeline->bind(commandBuffer);
+  }
+  pushModelConstants(commandBuffer);
+  model->bind(commandBuffer);
+  model->draw(commandBuffer);
+}
 
-  pipeline->bind(commandBuffers[imageIndex]);
-  model->bind(commandBuffers[imageIndex]);
-  model->draw(commandBuffers[imageIndex]);
+void App::pushModelConstants(VkCommandBuffer commandBuffer) {
+  SimplePushConstantData push{};
+  push.positionScale = scene.positionScale;
+  push.positionOffset = scene.positionOffset;
+  vkCmdPushConstants(commandBuffer,
+                     pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT,
+                     0,
+                     sizeof(SimplePushConstantData),
+                     &push);
+}
 
-  vkCmdEndRenderPass(commandBuffers[imageIndex]);
+void App::processInput() {
+  bool keyDown = window.isKeyPressed(GLFW_KEY_P);
+  if (keyDown && !depthPrepassKeyDown) {
+    nextSnapshot.depthPrepassEnabled = !nextSnapshot.depthPrepassEnabled;
+    LogMessage{LogSeverity::Info}
+        << "Depth prepass: "
+        << (nextSnapshot.depthPrepassEnabled ? "on" : "off");
+  }
+  depthPrepassKeyDown = keyDown;
+
+  keyDown = window.isKeyPressed(GLFW_KEY_O);
+  if (keyDown && !occlusionCullingKeyDown) {
+    nextSnapshot.occlusionCullingEnabled =
+        !nextSnapshot.occlusionCullingEnabled;
+    LogMessage{LogSeverity::Info}
+        << "Occlusion culling: "
+        << (nextSnapshot.occlusionCullingEnabled ? "on" : "off");
+  }
+  occlusionCullingKeyDown = keyDown;
+
+  keyDown = window.isKeyPressed(GLFW_KEY_R);
+  if (keyDown && !reactiveRenderingKeyDown) {
+    nextSnapshot.reactiveRendering = !nextSnapshot.reactiveRendering;
+    LogMessage{LogSeverity::Info}
+        << "Reactive rendering: "
+        << (nextSnapshot.reactiveRendering ? "on" : "off");
+  }
+  reactiveRenderingKeyDown = keyDown;
+}
 
-  if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS) {
-    throw std::runtime_error("failed to record command buffer");
+void App::waitForEvents() {
+  double now = glfwGetTime();
+  if (nextSnapshot.reactiveRendering && now >= animationDeadline) {
+    // nothing moves until an event arrives, or the render thread fails
+    glfwWaitEvents();
+  } else if (nextStepTime > now) {
+    glfwWaitEventsTimeout(nextStepTime - now);
+  } else {
+    glfwPollEvents();
+  }
+}
+
+void App::stepSimulation() {
+  double now = glfwGetTime();
+  if (now - nextStepTime > MAX_SIMULATION_BACKLOG * SIMULATION_STEP_SECONDS) {
+    // idle in reactive mode, or stalled; the missed steps are not replayed
+    nextStepTime = now;
+  }
+  while (nextStepTime <= now) {
+    // scene updates advance current by SIMULATION_STEP_SECONDS here; the
+    // scene is static so far
+    nextSnapshot.previous = nextSnapshot.current;
+    nextSnapshot.stepTime = nextStepTime;
+    nextStepTime += SIMULATION_STEP_SECONDS;
+  }
+}
+
+void App::publishSnapshot() {
+  if (window.isWindowResized()) {
+    window.resetWindowResizedFlag();
+    nextSnapshot.resizeCount++;
+  }
+  if (window.isRedrawRequested()) {
+    window.resetRedrawRequestedFlag();
+    nextSnapshot.redrawCount++;
+  }
+  nextSnapshot.extent = window.getExtent();
+  nextSnapshot.animating = glfwGetTime() < animationDeadline;
+
+  snapshots.getWriteBuffer() = nextSnapshot;
+  snapshots.publish();
+  wakeRenderThread();
+}
+
+void App::requestRedraw() { nextSnapshot.redrawCount++; }
+
+void App::requestAnimationFrames(double seconds) {
+  animationDeadline = std::max(animationDeadline, glfwGetTime() + seconds);
+}
+
+void App::reloadShaders() {
+  for (const auto &name : shaderWatcher.takeUpdatedShaders()) {
+    auto users = shaderUsers.find(name);
+    if (users == shaderUsers.end()) {
+      LogMessage{LogSeverity::Debug}
+          << "Shader " << name << " is not used by any pipeline";
+      continue;
+    }
+    staleShaderUsers |= users->second;
+  }
+
+  // one reload at a time; changes made meanwhile start the next one
+  if (pipelineReload != nullptr) {
+    if (!pipelineReload->built.isDone()) {
+      return;
+    }
+    finishPipelineReload();
+  }
+  if (staleShaderUsers != 0) {
+    startPipelineReload();
+  }
+}
+
+void App::startPipelineReload() {
+  auto reload = std::make_unique<PipelineReload>();
+  JobSystem &jobSystem = device.getJobSystem();
+  if (staleShaderUsers & FORWARD_PIPELINES) {
+    jobSystem.schedule(
+        reload->built,
+        [this,
+         reload = reload.get(),
+         renderPass = swapchain->getRenderPass(),
+         colorFormat = swapchain->getSwapChainImageFormat(),
+         depthFormat = swapchain->findDepthFormat()] {
+          reload->forwardPipelines = std::make_unique<ForwardPipelines>(
+              buildPipelines(renderPass, colorFormat, depthFormat));
+        },
+        "forward pipelines reload");
+  }
+  if (staleShaderUsers & HIZ_DOWNSAMPLE_PIPELINE) {
+    jobSystem.schedule(
+        reload->built,
+        [reload = reload.get(), culler = culler.get()] {
+          reload->hizDownsamplePipeline = culler->buildPipeline();
+        },
+        "hi-z downsample pipeline reload");
+  }
+  // one created later loads the new shader anyway
+  if ((staleShaderUsers & MIP_DOWNSAMPLE_PIPELINE) &&
+      mipmapGenerator.hasPipeline()) {
+    jobSystem.schedule(
+        reload->built,
+        [this, reload = reload.get()] {
+          reload->mipDownsamplePipeline = mipmapGenerator.buildPipeline();
+        },
+        "mip downsample pipeline reload");
+  }
+  staleShaderUsers = 0;
+  pipelineReload = std::move(reload);
+}
+
+void App::finishPipelineReload() {
+  if (pipelineReload == nullptr) {
+    return;
+  }
+  auto reload = std::move(pipelineReload);
+  // the SPIR-V compiled, but creating a pipeline can still fail, e.g. when
+  // the stage interfaces no longer match; the others are swapped in anyway
+  try {
+    device.getJobSystem().wait(reload->built);
+  } catch (const std::exception &e) {
+    LogMessage{LogSeverity::Error}
+        << "Failed to reload shaders, keeping the previous pipelines: "
+        << e.what();
+  }
+
+  if (reload->forwardPipelines != nullptr) {
+    installPipelines(std::move(*reload->forwardPipelines));
+  }
+  if (reload->hizDownsamplePipeline != nullptr) {
+    culler->replacePipeline(std::move(reload->hizDownsamplePipeline));
+    invalidateCommandBuffers();
+  }
+  if (reload->mipDownsamplePipeline != nullptr) {
+    mipmapGenerator.replacePipeline(std::move(reload->mipDownsamplePipeline));
   }
 }
 
-void App::drawFrame() {
+bool App::drawFrame() {
+  // every resize since the last frame is handled by one recreation at the
+  // latest extent
+  if (swapchainOutOfDate) {
+    if (windowExtent.width == 0 || windowExtent.height == 0) {
+      // minimized, there is nothing to present to until the next resize
+      return false;
+    }
+    recreateSwapChain();
+    swapchainOutOfDate = false;
+  }
+
   uint32_t imageIndex;
   auto result = swapchain->acquireNextImage(&imageIndex);
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-    recreateSwapChain();
-    return;
+    swapchainOutOfDate = true;
+    return true;
   }
 
   if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
     throw std::runtime_error("failed to acquire swap chain image");
   }
 
-  recordCommandBuffer(imageIndex);
-  result =
-      swapchain->submitCommandBuffers(&commandBuffers[imageIndex], &imageIndex);
+  // acquiring waited for the frame submitted MAX_FRAMES_IN_FLIGHT frames ago,
+  // so resources it used can be released
+  textureStreamer.update();
+  if (bindless != nullptr) {
+    bindless->update();
+  }
+  profiler.beginFrame(swapchain->getCurrentFrameIndex());
+  frameArena.beginFrame(swapchain->getCurrentFrameIndex());
+  VkCommandBuffer commandBuffer = recordCommandBuffer(imageIndex);
+  result = swapchain->submitCommandBuffers(&commandBuffer, &imageIndex);
+  if (framesRequested > 0) {
+    framesRequested--;
+  }
 
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-      window.isWindowResized()) {
-    window.resetWindowResizedFlag();
-    recreateSwapChain();
-    return;
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+    swapchainOutOfDate = true;
+    return true;
   }
 
   if (result != VK_SUCCESS) {
     throw std::runtime_error("failed to present swap chain image");
   }
+  return true;
 }
 
-void App::run() {
-  while (!window.shouldClose()) {
-    glfwPollEvents();
-    drawFrame();
+void App::requestFrames() {
+  // events arriving while frames are still requested coalesce into them
+  framesRequested = std::max(framesRequested, REDRAW_FRAMES);
+}
+
+void App::applySnapshot() {
+  snapshots.update();
+  const auto &snapshot = snapshots.getReadBuffer();
+
+  // frames trail the simulation by up to a step, so they always have both
+  // ends to interpolate between
+  float alpha = static_cast<float>(
+      (glfwGetTime() - snapshot.stepTime) / SIMULATION_STEP_SECONDS);
+  alpha = glm::clamp(alpha, 0.0f, 1.0f);
+  scene.positionScale = glm::mix(snapshot.previous.positionScale,
+                                 snapshot.current.positionScale,
+                                 alpha);
+  scene.positionOffset = glm::mix(snapshot.previous.positionOffset,
+                                  snapshot.current.positionOffset,
+                                  alpha);
+
+  if (snapshot.resizeCount != appliedResizeCount) {
+    appliedResizeCount = snapshot.resizeCount;
+    swapchainOutOfDate = true;
+  }
+  windowExtent = snapshot.extent;
+  if (snapshot.redrawCount != appliedRedrawCount) {
+    appliedRedrawCount = snapshot.redrawCount;
+    requestFrames();
+  }
+  animating = snapshot.animating;
+  reactiveRendering = snapshot.reactiveRendering;
+
+  if (snapshot.depthPrepassEnabled != depthPrepassEnabled) {
+    depthPrepassEnabled = snapshot.depthPrepassEnabled;
+    invalidateCommandBuffers();
+  }
+  if (snapshot.occlusionCullingEnabled != occlusionCullingEnabled) {
+    occlusionCullingEnabled = snapshot.occlusionCullingEnabled;
+    // Pyramids built before the pause no longer match the scene. As after a
+    // resize, the culler and graph are replaced rather than rewritten, and
+    // frames in flight keep the old ones until the deletion queue frees them.
+    finishPipelineReload();
+    culler = std::make_unique<OcclusionCuller>(
+        device, samplerCache, swapchain->getSwapChainExtent());
+    createRenderGraph();
+  }
+}
+
+bool App::needsRedraw() {
+  return framesRequested > 0 || swapchainOutOfDate || animating ||
+         // streaming only advances as frames complete
+         textureStreamer.getStatistics().uploadsInFlight > 0 ||
+         // rebuilt pipelines are swapped in at the start of a frame
+         pipelineReload != nullptr;
+}
+
+void App::reportUtilization() {
+  if (profiler.getElapsedSeconds() < UTILIZATION_REPORT_SECONDS) {
+    return;
+  }
+  auto stats = profiler.takeStatistics();
+  // from the render thread, which the logger never blocks
+  LogMessage message{LogSeverity::Info};
+  message << "Utilization ("
+          << (reactiveRendering ? "reactive" : "continuous")
+          << "): " << stats.frameCount << " frames in " << stats.wallSeconds
+          << " s, CPU " << 100.0 * stats.cpuSeconds / stats.wallSeconds
+          << "%, GPU ";
+  if (stats.gpuSeconds >= 0.0) {
+    message << 100.0 * stats.gpuSeconds / stats.wallSeconds << "%";
+  } else {
+    message << "unknown";
+  }
+  if (stats.recordingCount > 0) {
+    message << ", " << stats.recordingCount << " recordings of "
+            << 1e6 * stats.recordingSeconds / stats.recordingCount << " us";
   }
 
+  // every thread's allocations, so steady-state frames should report 0
+  uint64_t allocationCount = getHeapAllocationCount();
+  const auto &arenaStats = frameArena.getStatistics();
+  message << ", " << allocationCount - reportedAllocationCount
+          << " heap allocations, frame arena peak "
+          << arenaStats.peakFrameBytes / 1024 << " KiB";
+  reportedAllocationCount = allocationCount;
+
+  // made through the allocation callbacks by the driver and loader
+  uint64_t driverAllocationCount = 0;
+  for (const auto &scopeStats : device.getHostAllocator().getStatistics()) {
+    driverAllocationCount += scopeStats.allocationCount;
+  }
+  message << ", " << driverAllocationCount - reportedDriverAllocationCount
+          << " driver allocations";
+  reportedDriverAllocationCount = driverAllocationCount;
+}
+
+void App::waitForWork() {
+  // the timeout keeps the utilization reports coming while idle
+  std::chrono::duration<double> timeout{std::max(
+      UTILIZATION_REPORT_SECONDS - profiler.getElapsedSeconds(), 0.0)};
+  std::unique_lock<std::mutex> lock{wakeMutex};
+  wakeCondition.wait_for(lock, timeout, [this] { return wakeRequested; });
+  wakeRequested = false;
+}
+
+void App::wakeRenderThread() {
+  {
+    std::lock_guard<std::mutex> lock{wakeMutex};
+    wakeRequested = true;
+  }
+  wakeCondition.notify_one();
+}
+
+void App::renderLoop() {
+  try {
+    while (!stopRendering) {
+      applySnapshot();
+      reloadShaders();
+      bool drawn = false;
+      if (!reactiveRendering || needsRedraw()) {
+        drawn = drawFrame();
+      }
+      reportUtilization();
+      if (!drawn) {
+        // woken by new snapshots and recompiled shaders
+        waitForWork();
+      }
+    }
+  } catch (...) {
+    renderException = std::current_exception();
+    renderThreadFailed = true;
+    glfwPostEmptyEvent();
+  }
+
+  // jobs of a reload still in flight reference the app
+  if (pipelineReload != nullptr) {
+    try {
+      device.getJobSystem().wait(pipelineReload->built);
+    } catch (...) {
+      // already shutting down
+    }
+    pipelineReload = nullptr;
+  }
   vkDeviceWaitIdle(device.device());
 }
 
+void App::run() {
+  nextStepTime = glfwGetTime();
+  nextSnapshot.stepTime = nextStepTime;
+  publishSnapshot();
+  std::thread renderThread{&App::renderLoop, this};
+
+  // acquiring and presenting block the render thread, never the simulation
+  while (!window.shouldClose() && !renderThreadFailed) {
+    waitForEvents();
+    processInput();
+    stepSimulation();
+    publishSnapshot();
+  }
+
+  stopRendering = true;
+  wakeRenderThread();
+  renderThread.join();
+  if (renderException) {
+    std::rethrow_exception(renderException);
+  }
+  // after everything still queued for the same stream
+  Logger::get().flush();
+  device.getHostAllocator().exportStatistics(std::cout);
+}
+
 }  // namespace lve
@@ -1,11 +1,27 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "bindless_resources.h"
+#include "frame_arena.h"
+#include "frame_profiler.h"
+#include "mipmap_generator.h"
 #include "model.h"
+#include "occlusion_culler.h"
 #include "pipeline.h"
+#include "render_graph.h"
+#include "sampler_cache.h"
+#include "shader_watcher.h"
 #include "swapchain.h"
+#include "texture_streamer.h"
+#include "triple_buffer.h"
 #include "window.h"
 
 namespace lve {
@@ -14,6 +30,15 @@ class App {
  public:
   static constexpr int WIDTH = 800;
   static constexpr int HEIGHT = 600;
+  // device-local memory streamed textures may use at most
+  static constexpr VkDeviceSize TEXTURE_BUDGET = 256 * 1024 * 1024;
+  // the occlusion test reads the hi-z pyramid of a frame MAX_FRAMES_IN_FLIGHT
+  // back, so a change is only fully shown that many frames later
+  static constexpr int REDRAW_FRAMES = SwapChain::MAX_FRAMES_IN_FLIGHT + 1;
+  static constexpr double UTILIZATION_REPORT_SECONDS = 5.0;
+  static constexpr double SIMULATION_STEP_SECONDS = 1.0 / 60.0;
+  // a main thread further behind than this skips the missed steps
+  static constexpr int MAX_SIMULATION_BACKLOG = 8;
 
   App();
   ~App();
@@ -21,25 +46,212 @@ class App {
   App(const App&) = delete;
   App& operator=(const App&) = delete;
 
+  // Window events and the simulation run on the calling thread, at a fixed
+  // step; a render thread draws interpolated snapshots of the simulation.
   void run();
 
+  // Main thread only. In reactive mode frames are only drawn after something
+  // changed; these are for changes the app would not notice otherwise.
+  // Animations request every frame until they end.
+  void requestRedraw();
+  void requestAnimationFrames(double seconds);
+
  private:
+  struct SceneState {
+    glm::vec2 positionScale{1.0f, 1.0f};
+    glm::vec2 positionOffset{0.0f, 0.0f};
+  };
+
+  // Everything the render thread learns from the main thread, published
+  // after every iteration of the main loop.
+  struct FrameSnapshot {
+    // the last two simulation steps, which frames interpolate between
+    SceneState previous;
+    SceneState current;
+    // glfwGetTime() of the step that produced current
+    double stepTime = 0.0;
+    VkExtent2D extent{};
+    // bumped for every resize and window event
+    uint64_t resizeCount = 0;
+    uint64_t redrawCount = 0;
+    bool animating = false;
+    bool depthPrepassEnabled = true;
+    bool occlusionCullingEnabled = true;
+    bool reactiveRendering = false;
+  };
+
+  // The pipelines drawing the model, built together from the swapchain's
+  // attachment formats.
+  struct ForwardPipelines {
+    std::unique_ptr<Pipeline> pipeline;
+    std::unique_ptr<Pipeline> depthPrepassPipeline;
+    std::unique_ptr<Pipeline> depthEqualPipeline;
+    PipelineDynamicState depthEqualState{};
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+  };
+
+  // What a shader reload rebuilds, as bits of shaderUsers.
+  enum ShaderUser : uint32_t {
+    FORWARD_PIPELINES = 1 << 0,
+    HIZ_DOWNSAMPLE_PIPELINE = 1 << 1,
+    MIP_DOWNSAMPLE_PIPELINE = 1 << 2,
+  };
+
+  // Pipelines rebuilt as jobs after their shaders changed. The render thread
+  // swaps in whatever was built at the start of the first frame after all
+  // jobs finished.
+  struct PipelineReload {
+    JobCounter built;
+    std::unique_ptr<ForwardPipelines> forwardPipelines;
+    std::unique_ptr<Pipeline> hizDownsamplePipeline;
+    std::unique_ptr<Pipeline> mipDownsamplePipeline;
+  };
+
   void loadModels();
   void createPipelineLayout();
   void createPipeline();
+  // may run on any thread
+  ForwardPipelines buildPipelines(VkRenderPass renderPass,
+                                  VkFormat colorFormat,
+                                  VkFormat depthFormat);
+  void installPipelines(ForwardPipelines pipelines);
+  // records that rebuilding user depends on the shader compiled to spirvPath
+  void useShader(const std::string &spirvPath, ShaderUser user);
   void createCommandBuffers();
   void freeCommandBuffers();
-  void drawFrame();
+  // false when there is nothing to present to
+  bool drawFrame();
   void recreateSwapChain();
-  void recordCommandBuffer(int imageIndex);
+  void createRenderGraph();
+  void invalidateCommandBuffers();
+  VkCommandBuffer recordCommandBuffer(uint32_t imageIndex);
+  void recordForwardPass(VkCommandBuffer commandBuffer);
+  void recordDepthPrepass(VkCommandBuffer commandBuffer);
+  void recordColorPass(VkCommandBuffer commandBuffer);
+  void setViewportAndScissor(VkCommandBuffer commandBuffer);
+  void drawDepthPrepass(VkCommandBuffer commandBuffer);
+  void drawColor(VkCommandBuffer commandBuffer);
+  void pushModelConstants(VkCommandBuffer commandBuffer);
+  void requestFrames();
+
+  // main thread
+  void waitForEvents();
+  void processInput();
+  void stepSimulation();
+  void publishSnapshot();
+
+  // render thread
+  void renderLoop();
+  void applySnapshot();
+  void reloadShaders();
+  void startPipelineReload();
+  // waits for the reload's jobs if they are still running
+  void finishPipelineReload();
+  bool needsRedraw();
+  void reportUtilization();
+  void waitForWork();
+
+  // any thread
+  void wakeRenderThread();
 
   Window window{WIDTH, HEIGHT, "Hello Vulkan!"};
   Device device{window};
+  SamplerCache samplerCache{device};
+  // for textures whose mip chains are filled on the GPU; nothing generates
+  // any yet
+  MipmapGenerator mipmapGenerator{device, samplerCache};
+  FrameProfiler profiler{device};
+  FrameArena frameArena;
+  // getHeapAllocationCount() at the last utilization report
+  uint64_t reportedAllocationCount = 0;
+  // summed over the HostAllocator scopes at the last utilization report
+  uint64_t reportedDriverAllocationCount = 0;
+  // null without descriptor indexing; bound once per command buffer as set 0
+  // of pipelineLayout
+  std::unique_ptr<BindlessResources> bindless;
   std::unique_ptr<SwapChain> swapchain;
   std::unique_ptr<Pipeline> pipeline;
+  std::unique_ptr<Pipeline> depthPrepassPipeline;
+  // null when the device has extended dynamic state; pipeline is bound with
+  // depthEqualState instead
+  std::unique_ptr<Pipeline> depthEqualPipeline;
+  PipelineDynamicState depthEqualState{};
   VkPipelineLayout pipelineLayout;
+  VkFormat pipelineColorFormat = VK_FORMAT_UNDEFINED;
+  VkRenderPass pipelineRenderPass = VK_NULL_HANDLE;
+  // recreated before the next frame, so resize events coalesce
+  bool swapchainOutOfDate = false;
+  VkExtent2D windowExtent{};
+
+  // The render thread sleeps here when it has nothing to draw; snapshots
+  // themselves are exchanged without locks.
+  std::mutex wakeMutex;
+  std::condition_variable wakeCondition;
+  bool wakeRequested = false;
+  std::atomic<bool> stopRendering{false};
+  std::atomic<bool> renderThreadFailed{false};
+  std::exception_ptr renderException;
+
+  ShaderWatcher shaderWatcher{"src/shaders", [this] { wakeRenderThread(); }};
+  // ShaderUser bits by shader source name, e.g. "simple_shader.frag"
+  std::unordered_map<std::string, uint32_t> shaderUsers;
+  // sources changed since the running reload started
+  uint32_t staleShaderUsers = 0;
+  std::unique_ptr<PipelineReload> pipelineReload;
+  TextureStreamer textureStreamer{device, TEXTURE_BUDGET};
+
+  // What a command buffer was recorded with. Buffers are only recorded again
+  // when contentVersion or the culling result changed since.
+  struct RecordedContent {
+    uint64_t version = 0;
+    bool modelVisible = false;
+    SceneState scene;
+  };
+
+  // one per frame slot and swapchain image, indexed like the framebuffers,
+  // so a recorded buffer is never pending when its slot comes around again
   std::vector<VkCommandBuffer> commandBuffers;
+  std::vector<RecordedContent> recordedContents;
+  uint64_t contentVersion = 1;
+  // LVE_RECORD_EVERY_FRAME at startup, to measure command recording cost
+  bool recordEveryFrame = false;
   std::unique_ptr<Model> model;
+  // declared before the culler, whose views reference the graph's pyramid
+  std::unique_ptr<RenderGraph> renderGraph;
+  RenderGraphResource backbufferResource;
+  RenderGraphResource depthResource;
+  RenderGraphResource readbackResource;
+  std::unique_ptr<OcclusionCuller> culler;
+
+  // what the render graph passes record for
+  int recordFrameIndex = 0;
+  int recordImageIndex = 0;
+  bool modelVisible = true;
+  // interpolated between the snapshot's steps
+  SceneState scene;
+
+  // main thread: the snapshot being built, and the simulation it steps
+  TripleBuffer<FrameSnapshot> snapshots;
+  FrameSnapshot nextSnapshot;
+  double nextStepTime = 0.0;
+  // glfwGetTime() until which animations want every frame
+  double animationDeadline = 0.0;
+  bool depthPrepassKeyDown = false;
+  bool occlusionCullingKeyDown = false;
+  bool reactiveRenderingKeyDown = false;
+
+  // Render thread: the snapshot settings applied so far.
+  // P compares shading cost with and without the prepass, O toggles hi-z
+  // occlusion culling against last frame's depth, and R, or LVE_REACTIVE set
+  // at startup, waits for events instead of drawing continuously.
+  bool depthPrepassEnabled = true;
+  bool occlusionCullingEnabled = true;
+  bool reactiveRendering = false;
+  bool animating = false;
+  uint64_t appliedResizeCount = 0;
+  uint64_t appliedRedrawCount = 0;
+  int framesRequested = 0;
 };
 
 }  // namespace lve
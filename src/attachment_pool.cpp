@@ -0,0 +1,167 @@
+#include "attachment_pool.h"
+
+// std headers
+#include <stdexcept>
+
+namespace lve {
+
+AttachmentPool::AttachmentPool(Device &device) : device{device} {}
+
+AttachmentPool::~AttachmentPool() {
+  for (auto &entry : entries) {
+    destroyEntry(entry);
+  }
+}
+
+PooledAttachment AttachmentPool::acquire(const AttachmentDesc &desc,
+                                         VkExtent2D extent,
+                                         int frameIndex) {
+  for (auto &entry : entries) {
+    if (entry.frameIndex != frameIndex || entry.desc.format != desc.format ||
+        entry.desc.usage != desc.usage || entry.desc.aspect != desc.aspect) {
+      continue;
+    }
+    if (!fits(entry, extent)) {
+      destroyEntry(entry);
+      createEntry(entry, extent);
+    }
+    return entry.attachment;
+  }
+
+  Entry entry{};
+  entry.desc = desc;
+  entry.frameIndex = frameIndex;
+  createEntry(entry, extent);
+  entries.push_back(entry);
+  return entry.attachment;
+}
+
+VkDeviceSize AttachmentPool::allocatedBytes() const {
+  VkDeviceSize total = 0;
+  for (const auto &entry : entries) {
+    total += entry.size;
+  }
+  return total;
+}
+
+bool AttachmentPool::isTransient(VkImageUsageFlags usage) {
+  const VkImageUsageFlags attachmentUsage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  return (usage & ~attachmentUsage) == 0;
+}
+
+bool AttachmentPool::fits(const Entry &entry, VkExtent2D extent) const {
+  const VkExtent2D &allocated = entry.attachment.extent;
+  if (extent.width > allocated.width || extent.height > allocated.height) {
+    return false;
+  }
+  // give memory back once the window has shrunk a lot
+  uint64_t allocatedArea =
+      static_cast<uint64_t>(allocated.width) * allocated.height;
+  uint64_t requestedArea = static_cast<uint64_t>(extent.width) * extent.height;
+  return requestedArea * 4 >= allocatedArea;
+}
+
+void AttachmentPool::createEntry(Entry &entry, VkExtent2D extent) {
+  auto roundUp = [](uint32_t value) {
+    return (value + EXTENT_GRANULARITY - 1) / EXTENT_GRANULARITY *
+           EXTENT_GRANULARITY;
+  };
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = roundUp(extent.width);
+  imageInfo.extent.height = roundUp(extent.height);
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = entry.desc.format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = entry.desc.usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.flags = 0;
+
+  bool transient = isTransient(entry.desc.usage);
+  if (transient) {
+    imageInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  }
+
+  if (vkCreateImage(device.device(),
+                    &imageInfo,
+                    device.allocator(),
+                    &entry.attachment.image) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create image!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(
+      device.device(), entry.attachment.image, &memRequirements);
+
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  if (transient &&
+      device.hasMemoryType(memRequirements.memoryTypeBits,
+                           VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+    properties = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  }
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex =
+      device.findMemoryType(memRequirements.memoryTypeBits, properties);
+
+  if (vkAllocateMemory(
+          device.device(), &allocInfo, device.allocator(), &entry.memory) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate image memory!");
+  }
+
+  if (vkBindImageMemory(
+          device.device(), entry.attachment.image, entry.memory, 0) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to bind image memory!");
+  }
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = entry.attachment.image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = entry.desc.format;
+  viewInfo.subresourceRange.aspectMask = entry.desc.aspect;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device.device(),
+                        &viewInfo,
+                        device.allocator(),
+                        &entry.attachment.view) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture image view!");
+  }
+
+  entry.attachment.extent = {imageInfo.extent.width, imageInfo.extent.height};
+  // lazily allocated memory is committed on demand and usually never is
+  entry.size = properties == VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+                   ? 0
+                   : memRequirements.size;
+}
+
+void AttachmentPool::destroyEntry(Entry &entry) {
+  device.getDeletionQueue().push([device = device.device(),
+                                  allocator = device.allocator(),
+                                  view = entry.attachment.view,
+                                  image = entry.attachment.image,
+                                  memory = entry.memory] {
+    vkDestroyImageView(device, view, allocator);
+    vkDestroyImage(device, image, allocator);
+    vkFreeMemory(device, memory, allocator);
+  });
+}
+
+}  // namespace lve
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "device.h"
+
+// std lib headers
+#include <vector>
+
+namespace lve {
+
+struct AttachmentDesc {
+  VkFormat format;
+  VkImageUsageFlags usage;
+  VkImageAspectFlags aspect;
+};
+
+struct PooledAttachment {
+  VkImage image;
+  VkImageView view;
+  VkExtent2D extent;
+};
+
+// Render-target images shared by everything that renders a frame slot.
+//
+// There is one image per (description, frame slot) rather than per swapchain
+// image, since only MAX_FRAMES_IN_FLIGHT frames can use them at once. Images
+// are kept across swapchain recreation and reused while the requested extent
+// fits; allocations are rounded up so a window drag does not reallocate on
+// every step. Attachments that are never sampled, stored or copied get
+// TRANSIENT_ATTACHMENT usage and lazily allocated memory where the device
+// has it, so tiled GPUs can keep them in on-chip memory.
+class AttachmentPool {
+ public:
+  static constexpr uint32_t EXTENT_GRANULARITY = 64;
+
+  AttachmentPool(Device &device);
+  ~AttachmentPool();
+
+  AttachmentPool(const AttachmentPool &) = delete;
+  AttachmentPool &operator=(const AttachmentPool &) = delete;
+
+  // The previous image of this slot is released through the deletion queue
+  // if it no longer fits, so frames still using it are unaffected.
+  PooledAttachment acquire(const AttachmentDesc &desc,
+                           VkExtent2D extent,
+                           int frameIndex);
+
+  VkDeviceSize allocatedBytes() const;
+
+ private:
+  struct Entry {
+    AttachmentDesc desc;
+    int frameIndex;
+    PooledAttachment attachment;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+  };
+
+  static bool isTransient(VkImageUsageFlags usage);
+  bool fits(const Entry &entry, VkExtent2D extent) const;
+  void createEntry(Entry &entry, VkExtent2D extent);
+  void destroyEntry(Entry &entry);
+
+  Device &device;
+  std::vector<Entry> entries;
+};
+
+}  // namespace lve
@@ -0,0 +1,212 @@
+#include "bindless_resources.h"
+
+#include "swapchain.h"
+
+// std lib headers
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace lve {
+
+BindlessResources::BindlessResources(Device &device) : device{device} {
+  const auto &limits = device.descriptorIndexingProperties;
+  // combined image samplers count against both the image and sampler limits
+  textures.capacity =
+      std::min({MAX_TEXTURES,
+                limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+                limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                limits.maxDescriptorSetUpdateAfterBindSamplers});
+  buffers.capacity =
+      std::min({MAX_BUFFERS,
+                limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                limits.maxDescriptorSetUpdateAfterBindStorageBuffers});
+
+  createDescriptorSetLayout();
+  createDescriptorPool();
+  allocateDescriptorSet();
+}
+
+BindlessResources::~BindlessResources() {
+  vkDestroyDescriptorPool(device.device(), descriptorPool, device.allocator());
+  vkDestroyDescriptorSetLayout(
+      device.device(), descriptorSetLayout, device.allocator());
+}
+
+void BindlessResources::createDescriptorSetLayout() {
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+  bindings[0].binding = TEXTURE_BINDING;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = textures.capacity;
+  bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+  bindings[1].binding = BUFFER_BINDING;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[1].descriptorCount = buffers.capacity;
+  bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+  // unregistered slots are never read, and registering only touches slots
+  // no pending frame uses
+  VkDescriptorBindingFlags flags =
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+  std::array<VkDescriptorBindingFlags, 2> bindingFlags{flags, flags};
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+  bindingFlagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &bindingFlagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(device.device(),
+                                  &layoutInfo,
+                                  device.allocator(),
+                                  &descriptorSetLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create bindless descriptor layout!");
+  }
+}
+
+void BindlessResources::createDescriptorPool() {
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = textures.capacity;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[1].descriptorCount = buffers.capacity;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  if (vkCreateDescriptorPool(
+          device.device(), &poolInfo, device.allocator(), &descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create bindless descriptor pool!");
+  }
+}
+
+void BindlessResources::allocateDescriptorSet() {
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &descriptorSetLayout;
+
+  if (vkAllocateDescriptorSets(device.device(), &allocInfo, &descriptorSet) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate bindless descriptor set!");
+  }
+}
+
+BindlessIndex BindlessResources::registerTexture(VkImageView imageView,
+                                                 VkSampler sampler,
+                                                 VkImageLayout imageLayout) {
+  BindlessIndex index = textures.allocate();
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = sampler;
+  imageInfo.imageView = imageView;
+  imageInfo.imageLayout = imageLayout;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptorSet;
+  write.dstBinding = TEXTURE_BINDING;
+  write.dstArrayElement = index;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+  return index;
+}
+
+BindlessIndex BindlessResources::registerBuffer(VkBuffer buffer,
+                                                VkDeviceSize offset,
+                                                VkDeviceSize range) {
+  BindlessIndex index = buffers.allocate();
+
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = offset;
+  bufferInfo.range = range;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptorSet;
+  write.dstBinding = BUFFER_BINDING;
+  write.dstArrayElement = index;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+  return index;
+}
+
+void BindlessResources::releaseTexture(BindlessIndex index) {
+  textures.release(index);
+}
+
+void BindlessResources::releaseBuffer(BindlessIndex index) {
+  buffers.release(index);
+}
+
+void BindlessResources::update() {
+  textures.update();
+  buffers.update();
+}
+
+void BindlessResources::bind(VkCommandBuffer commandBuffer,
+                             VkPipelineBindPoint bindPoint,
+                             VkPipelineLayout pipelineLayout,
+                             uint32_t firstSet) {
+  vkCmdBindDescriptorSets(commandBuffer,
+                          bindPoint,
+                          pipelineLayout,
+                          firstSet,
+                          1,
+                          &descriptorSet,
+                          0,
+                          nullptr);
+}
+
+BindlessIndex BindlessResources::SlotAllocator::allocate() {
+  if (!freeIndices.empty()) {
+    BindlessIndex index = freeIndices.back();
+    freeIndices.pop_back();
+    return index;
+  }
+  if (nextUnused == capacity) {
+    throw std::runtime_error("failed to register bindless resource, full!");
+  }
+  return nextUnused++;
+}
+
+void BindlessResources::SlotAllocator::release(BindlessIndex index) {
+  retired.push_back({index, SwapChain::MAX_FRAMES_IN_FLIGHT});
+}
+
+void BindlessResources::SlotAllocator::update() {
+  for (auto &slot : retired) {
+    if (--slot.framesLeft == 0) {
+      freeIndices.push_back(slot.index);
+    }
+  }
+  retired.erase(std::remove_if(retired.begin(),
+                               retired.end(),
+                               [](const RetiredSlot &slot) {
+                                 return slot.framesLeft == 0;
+                               }),
+                retired.end());
+}
+
+}  // namespace lve
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "device.h"
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+using BindlessIndex = uint32_t;
+
+// One descriptor set holding every texture and storage buffer, as two large
+// update-after-bind arrays. Resources are registered once and shaders address
+// them by the returned index, passed in push constants or instance data, so
+// the set is bound once per command buffer instead of per draw:
+//
+//   #extension GL_EXT_nonuniform_qualifier : require
+//   layout(set = 0, binding = 0) uniform sampler2D textures[];
+//   layout(set = 0, binding = 1) readonly buffer Buffers {
+//     uint data[];
+//   } buffers[];
+//
+//   texture(textures[nonuniformEXT(index)], uv)
+//
+// Only usable when Device::supportsDescriptorIndexing().
+class BindlessResources {
+ public:
+  static constexpr uint32_t TEXTURE_BINDING = 0;
+  static constexpr uint32_t BUFFER_BINDING = 1;
+  // upper bounds, lowered to the device limits
+  static constexpr uint32_t MAX_TEXTURES = 16384;
+  static constexpr uint32_t MAX_BUFFERS = 4096;
+
+  BindlessResources(Device &device);
+  ~BindlessResources();
+
+  BindlessResources(const BindlessResources &) = delete;
+  BindlessResources &operator=(const BindlessResources &) = delete;
+
+  VkDescriptorSetLayout getDescriptorSetLayout() const {
+    return descriptorSetLayout;
+  }
+  uint32_t getTextureCapacity() const { return textures.capacity; }
+  uint32_t getBufferCapacity() const { return buffers.capacity; }
+
+  BindlessIndex registerTexture(
+      VkImageView imageView,
+      VkSampler sampler,
+      VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  BindlessIndex registerBuffer(VkBuffer buffer,
+                               VkDeviceSize offset = 0,
+                               VkDeviceSize range = VK_WHOLE_SIZE);
+  // The index is handed out again once the frames in flight that may still
+  // read it are done. A registered resource is never rewritten in place, as
+  // a pending frame may be reading it; register the replacement and release
+  // the old index instead.
+  void releaseTexture(BindlessIndex index);
+  void releaseBuffer(BindlessIndex index);
+
+  // Call once per frame, after the frame slot's fence has been waited on.
+  void update();
+
+  void bind(VkCommandBuffer commandBuffer,
+            VkPipelineBindPoint bindPoint,
+            VkPipelineLayout pipelineLayout,
+            uint32_t firstSet = 0);
+
+ private:
+  struct SlotAllocator {
+    struct RetiredSlot {
+      BindlessIndex index;
+      int framesLeft;
+    };
+
+    uint32_t capacity = 0;
+    uint32_t nextUnused = 0;
+    std::vector<BindlessIndex> freeIndices;
+    std::vector<RetiredSlot> retired;
+
+    BindlessIndex allocate();
+    void release(BindlessIndex index);
+    void update();
+  };
+
+  void createDescriptorSetLayout();
+  void createDescriptorPool();
+  void allocateDescriptorSet();
+
+  Device &device;
+  SlotAllocator textures;
+  SlotAllocator buffers;
+  VkDescriptorSetLayout descriptorSetLayout;
+  VkDescriptorPool descriptorPool;
+  VkDescriptorSet descriptorSet;
+};
+
+}  // namespace lve
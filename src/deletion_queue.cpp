@@ -0,0 +1,26 @@
+#include "deletion_queue.h"
+
+namespace lve {
+
+void DeletionQueue::push(std::function<void()> deleter) {
+  entries.push_back({frame, std::move(deleter)});
+}
+
+void DeletionQueue::collect(uint64_t completedFrame) {
+  while (!entries.empty() && entries.front().frame <= completedFrame) {
+    // deleters may queue more work, so take it off the queue first
+    auto deleter = std::move(entries.front().deleter);
+    entries.pop_front();
+    deleter();
+  }
+}
+
+void DeletionQueue::flush() {
+  while (!entries.empty()) {
+    auto deleter = std::move(entries.front().deleter);
+    entries.pop_front();
+    deleter();
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,48 @@
+#pragma once
+
+// std lib headers
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace lve {
+
+// Vulkan objects released while the GPU may still be using them.
+//
+// Frames are numbered from 1. A deleter is tagged with the frame being
+// recorded when it was pushed and runs once that frame has completed, as
+// reported by whoever waits on the frame's fence. Nothing has to drain the
+// GPU to release a resource.
+class DeletionQueue {
+ public:
+  DeletionQueue() = default;
+
+  DeletionQueue(const DeletionQueue &) = delete;
+  DeletionQueue &operator=(const DeletionQueue &) = delete;
+
+  void push(std::function<void()> deleter);
+
+  // the frame whose commands are being recorded
+  uint64_t currentFrame() const { return frame; }
+  // Marks the current frame as submitted and returns its number, to be passed
+  // to collect() once its fence has signaled.
+  uint64_t endFrame() { return frame++; }
+  // runs the deleters of every frame up to and including completedFrame
+  void collect(uint64_t completedFrame);
+  // Runs every deleter; only valid when the device is idle.
+  void flush();
+
+  size_t size() const { return entries.size(); }
+
+ private:
+  struct Entry {
+    uint64_t frame;
+    std::function<void()> deleter;
+  };
+
+  uint64_t frame = 1;
+  // ordered by frame, as frames only move forward
+  std::deque<Entry> entries;
+};
+
+}  // namespace lve
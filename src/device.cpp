@@ -1,8 +1,12 @@
 #include "device.h"
 
+#include "logger.h"
+
 // std headers
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <set>
 #include <unordered_set>
 
@@ -13,7 +17,19 @@ debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
               VkDebugUtilsMessageTypeFlagsEXT messageType,
               const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
               void *pUserData) {
-  std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+  LogSeverity severity = LogSeverity::Debug;
+  if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+    severity = LogSeverity::Error;
+  } else if (messageSeverity &
+             VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+    severity = LogSeverity::Warning;
+  } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+    severity = LogSeverity::Info;
+  }
+  // called from whichever thread made the offending call, so this must not
+  // block; the message ID rate limits repeats
+  LogMessage{severity, static_cast<uint32_t>(pCallbackData->messageIdNumber)}
+      << "validation layer: " << pCallbackData->pMessage;
 
   return VK_FALSE;
 }
@@ -23,10 +39,9 @@ VkResult CreateDebugUtilsMessengerEXT(
     const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
     const VkAllocationCallbacks *pAllocator,
     VkDebugUtilsMessengerEXT *pDebugMessenger) {
-  auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
-      instance, "vkCreateDebugUtilsMessengerEXT");
-  if (func != nullptr) {
-    return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+  if (vkCreateDebugUtilsMessengerEXT != nullptr) {
+    return vkCreateDebugUtilsMessengerEXT(
+        instance, pCreateInfo, pAllocator, pDebugMessenger);
   } else {
     return VK_ERROR_EXTENSION_NOT_PRESENT;
   }
@@ -35,11 +50,218 @@ VkResult CreateDebugUtilsMessengerEXT(
 void DestroyDebugUtilsMessengerEXT(VkInstance instance,
                                    VkDebugUtilsMessengerEXT debugMessenger,
                                    const VkAllocationCallbacks *pAllocator) {
-  auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
-      instance, "vkDestroyDebugUtilsMessengerEXT");
-  if (func != nullptr) {
-    func(instance, debugMessenger, pAllocator);
+  if (vkDestroyDebugUtilsMessengerEXT != nullptr) {
+    vkDestroyDebugUtilsMessengerEXT(instance, debugMessenger, pAllocator);
+  }
+}
+
+// What pickPhysicalDevice ranks a physical device on; logged for every device
+// so the choice can be confirmed on multi-GPU machines.
+struct DeviceCandidate {
+  VkPhysicalDevice device;
+  VkPhysicalDeviceProperties properties;
+  std::string uuid;
+  VkDeviceSize deviceLocalMemory = 0;
+  bool dedicatedCompute = false;
+  bool dedicatedTransfer = false;
+  std::vector<const char *> features;
+  bool suitable = false;
+  int64_t score = 0;
+};
+
+static bool hasDeviceExtension(VkPhysicalDevice device,
+                               const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(
+      device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      device, nullptr, &extensionCount, availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
   }
+  return false;
+}
+
+static const char *deviceTypeName(VkPhysicalDeviceType type) {
+  switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      return "cpu";
+    default:
+      return "other";
+  }
+}
+
+static std::string formatUuid(const uint8_t *uuid) {
+  const char *digits = "0123456789abcdef";
+  std::string text;
+  for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+    if (i == 4 || i == 6 || i == 8 || i == 10) {
+      text += '-';
+    }
+    text += digits[uuid[i] >> 4];
+    text += digits[uuid[i] & 0xf];
+  }
+  return text;
+}
+
+// lowercase without dashes, so either spelling of a UUID matches
+static std::string normalizeUuid(const std::string &uuid) {
+  std::string normalized;
+  for (char c : uuid) {
+    if (c != '-') {
+      normalized += static_cast<char>(
+          std::tolower(static_cast<unsigned char>(c)));
+    }
+  }
+  return normalized;
+}
+
+// LVE_DEVICE selects a device by its UUID or by part of its name
+static bool matchesDeviceOverride(const DeviceCandidate &candidate,
+                                  const std::string &selection) {
+  if (!candidate.uuid.empty() &&
+      normalizeUuid(candidate.uuid) == normalizeUuid(selection)) {
+    return true;
+  }
+  return std::string{candidate.properties.deviceName}.find(selection) !=
+         std::string::npos;
+}
+
+static DeviceCandidate describeDevice(VkPhysicalDevice device) {
+  DeviceCandidate candidate{};
+  candidate.device = device;
+  vkGetPhysicalDeviceProperties(device, &candidate.properties);
+  uint32_t apiVersion = candidate.properties.apiVersion;
+
+  if (apiVersion >= VK_API_VERSION_1_1) {
+    VkPhysicalDeviceIDProperties idProperties = {};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+    candidate.uuid = formatUuid(idProperties.deviceUUID);
+  }
+
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    const auto &heap = memoryProperties.memoryHeaps[i];
+    if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      candidate.deviceLocalMemory =
+          std::max(candidate.deviceLocalMemory, heap.size);
+    }
+  }
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      device, &queueFamilyCount, queueFamilies.data());
+  for (const auto &queueFamily : queueFamilies) {
+    VkQueueFlags flags = queueFamily.queueFlags;
+    if (queueFamily.queueCount == 0 || flags & VK_QUEUE_GRAPHICS_BIT) {
+      continue;
+    }
+    if (flags & VK_QUEUE_COMPUTE_BIT) {
+      candidate.dedicatedCompute = true;
+    } else if (flags & VK_QUEUE_TRANSFER_BIT) {
+      candidate.dedicatedTransfer = true;
+    }
+  }
+
+  // the same conditions createLogicalDevice enables them under
+  if (apiVersion >= VK_API_VERSION_1_3 ||
+      (apiVersion >= VK_API_VERSION_1_2 &&
+       hasDeviceExtension(device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))) {
+    candidate.features.push_back("dynamic_rendering");
+  }
+  if (apiVersion >= VK_API_VERSION_1_3 ||
+      (apiVersion >= VK_API_VERSION_1_1 &&
+       hasDeviceExtension(device,
+                          VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME))) {
+    candidate.features.push_back("extended_dynamic_state");
+  }
+  if (apiVersion >= VK_API_VERSION_1_2 ||
+      (apiVersion >= VK_API_VERSION_1_1 &&
+       hasDeviceExtension(device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))) {
+    candidate.features.push_back("descriptor_indexing");
+  }
+  if (apiVersion >= VK_API_VERSION_1_1 &&
+      hasDeviceExtension(device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    candidate.features.push_back("memory_budget");
+  }
+  return candidate;
+}
+
+// Device type dominates, so an integrated GPU never beats a discrete one;
+// within a type, more device-local memory wins, then dedicated queues and
+// optional features break ties.
+static int64_t scoreDevice(const DeviceCandidate &candidate) {
+  int64_t score = 0;
+  switch (candidate.properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      score += 1000000;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      score += 500000;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      score += 200000;
+      break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      break;
+    default:
+      score += 100000;
+      break;
+  }
+  score += static_cast<int64_t>(candidate.deviceLocalMemory / (1024 * 1024));
+  if (candidate.dedicatedCompute) {
+    score += 1000;
+  }
+  if (candidate.dedicatedTransfer) {
+    score += 1000;
+  }
+  score += 500 * static_cast<int64_t>(candidate.features.size());
+  return score;
+}
+
+static void logDeviceCandidate(size_t index,
+                               const DeviceCandidate &candidate,
+                               bool selected) {
+  uint32_t apiVersion = candidate.properties.apiVersion;
+  LogMessage message{LogSeverity::Info};
+  message << "gpu[" << index << "]: name=\"" << candidate.properties.deviceName
+          << "\""
+          << " type=" << deviceTypeName(candidate.properties.deviceType)
+          << " api=" << VK_API_VERSION_MAJOR(apiVersion) << "."
+          << VK_API_VERSION_MINOR(apiVersion) << "."
+          << VK_API_VERSION_PATCH(apiVersion)
+          << " uuid=" << (candidate.uuid.empty() ? "-" : candidate.uuid)
+          << " vram_mib=" << candidate.deviceLocalMemory / (1024 * 1024)
+          << " dedicated_compute=" << (candidate.dedicatedCompute ? 1 : 0)
+          << " dedicated_transfer=" << (candidate.dedicatedTransfer ? 1 : 0)
+          << " features=";
+  for (size_t i = 0; i < candidate.features.size(); i++) {
+    message << (i > 0 ? "," : "") << candidate.features[i];
+  }
+  if (candidate.features.empty()) {
+    message << "-";
+  }
+  message << " suitable=" << (candidate.suitable ? 1 : 0)
+          << " score=" << candidate.score
+          << " selected=" << (selected ? 1 : 0);
 }
 
 // class member functions
@@ -53,18 +275,22 @@ Device::Device(Window &window) : window{window} {
 }
 
 Device::~Device() {
-  vkDestroyCommandPool(device_, commandPool, nullptr);
-  vkDestroyDevice(device_, nullptr);
+  // everything has been released by now, and the device is idle
+  deletionQueue.flush();
+  vkDestroyCommandPool(device_, commandPool, allocator());
+  vkDestroyDevice(device_, allocator());
 
   if (enableValidationLayers) {
-    DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+    DestroyDebugUtilsMessengerEXT(instance, debugMessenger, allocator());
   }
 
-  vkDestroySurfaceKHR(instance, surface_, nullptr);
-  vkDestroyInstance(instance, nullptr);
+  vkDestroySurfaceKHR(instance, surface_, allocator());
+  vkDestroyInstance(instance, allocator());
+  unloadVulkanLibrary();
 }
 
 void Device::createInstance() {
+  loadVulkanLibrary();
   if (enableValidationLayers && !checkValidationLayerSupport()) {
     throw std::runtime_error("validation layers requested, but not available!");
   }
@@ -75,7 +301,8 @@ void Device::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // 1.3 lets devices that support it use dynamic rendering from core
+  appInfo.apiVersion = VK_API_VERSION_1_3;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -98,9 +325,10 @@ void Device::createInstance() {
     createInfo.pNext = nullptr;
   }
 
-  if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+  if (vkCreateInstance(&createInfo, allocator(), &instance) != VK_SUCCESS) {
     throw std::runtime_error("failed to create instance!");
   }
+  loadInstanceCommands(instance);
 
   hasGlfwRequiredInstanceExtensions();
 }
@@ -111,23 +339,50 @@ void Device::pickPhysicalDevice() {
   if (deviceCount == 0) {
     throw std::runtime_error("failed to find GPUs with Vulkan support!");
   }
-  std::cout << "Device count: " << deviceCount << std::endl;
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
+  std::vector<DeviceCandidate> candidates;
   for (const auto &device : devices) {
-    if (isDeviceSuitable(device)) {
-      physicalDevice = device;
-      break;
+    DeviceCandidate candidate = describeDevice(device);
+    candidate.suitable = isDeviceSuitable(device);
+    candidate.score = scoreDevice(candidate);
+    candidates.push_back(candidate);
+  }
+
+  const char *selection = std::getenv("LVE_DEVICE");
+  const DeviceCandidate *selected = nullptr;
+  for (const auto &candidate : candidates) {
+    if (!candidate.suitable) {
+      continue;
     }
+    if (selection != nullptr) {
+      if (matchesDeviceOverride(candidate, selection)) {
+        selected = &candidate;
+        break;
+      }
+    } else if (selected == nullptr || candidate.score > selected->score) {
+      selected = &candidate;
+    }
+  }
+
+  if (selection != nullptr) {
+    LogMessage{LogSeverity::Info}
+        << "gpu selection: LVE_DEVICE=\"" << selection << "\"";
+  }
+  for (size_t i = 0; i < candidates.size(); i++) {
+    logDeviceCandidate(i, candidates[i], &candidates[i] == selected);
   }
 
-  if (physicalDevice == VK_NULL_HANDLE) {
+  if (selected == nullptr && selection != nullptr) {
+    throw std::runtime_error("failed to find a suitable GPU for LVE_DEVICE!");
+  }
+  if (selected == nullptr) {
     throw std::runtime_error("failed to find a suitable GPU!");
   }
 
-  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-  std::cout << "physical device: " << properties.deviceName << std::endl;
+  physicalDevice = selected->device;
+  properties = selected->properties;
 }
 
 void Device::createLogicalDevice() {
@@ -147,11 +402,113 @@ void Device::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  storageImageWriteWithoutFormatSupported =
+      supportedFeatures.shaderStorageImageWriteWithoutFormat;
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      physicalDevice, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      physicalDevice, &queueFamilyCount, queueFamilies.data());
+  graphicsTimestampValidBits =
+      queueFamilies[indices.graphicsFamily].timestampValidBits;
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  deviceFeatures.shaderStorageImageWriteWithoutFormat =
+      supportedFeatures.shaderStorageImageWriteWithoutFormat;
+
+  std::vector<const char *> enabledExtensions = deviceExtensions;
+
+  bool dynamicRenderingCore = properties.apiVersion >= VK_API_VERSION_1_3;
+  bool dynamicRenderingExtension =
+      !dynamicRenderingCore && properties.apiVersion >= VK_API_VERSION_1_2 &&
+      isDeviceExtensionAvailable(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+  if (dynamicRenderingExtension) {
+    enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+  }
+  dynamicRenderingSupported = dynamicRenderingCore || dynamicRenderingExtension;
+
+  memoryBudgetSupported =
+      properties.apiVersion >= VK_API_VERSION_1_1 &&
+      isDeviceExtensionAvailable(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (memoryBudgetSupported) {
+    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+
+  // core in 1.3 without a feature bit; the extension has to be enabled along
+  // with its feature
+  bool extendedDynamicStateCore = properties.apiVersion >= VK_API_VERSION_1_3;
+  bool extendedDynamicStateExtension =
+      !extendedDynamicStateCore && isExtendedDynamicStateFeatureAvailable();
+  if (extendedDynamicStateExtension) {
+    enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+  }
+  extendedDynamicStateSupported =
+      extendedDynamicStateCore || extendedDynamicStateExtension;
+
+  // core in 1.2, but the features still have to be enabled
+  descriptorIndexingSupported = isDescriptorIndexingFeatureAvailable();
+  if (descriptorIndexingSupported &&
+      properties.apiVersion < VK_API_VERSION_1_2) {
+    enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  }
+  if (descriptorIndexingSupported) {
+    descriptorIndexingProperties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+  }
+
+  void *featureChain = nullptr;
+
+  VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {};
+  descriptorIndexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+  descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+  descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending =
+      VK_TRUE;
+  descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind =
+      VK_TRUE;
+  descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind =
+      VK_TRUE;
+  descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing =
+      VK_TRUE;
+  descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing =
+      VK_TRUE;
+  if (descriptorIndexingSupported) {
+    descriptorIndexingFeatures.pNext = featureChain;
+    featureChain = &descriptorIndexingFeatures;
+  }
+
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures =
+      {};
+  extendedDynamicStateFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+  if (extendedDynamicStateExtension) {
+    extendedDynamicStateFeatures.pNext = featureChain;
+    featureChain = &extendedDynamicStateFeatures;
+  }
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+  dynamicRenderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+  if (dynamicRenderingSupported) {
+    dynamicRenderingFeatures.pNext = featureChain;
+    featureChain = &dynamicRenderingFeatures;
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = featureChain;
 
   createInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
@@ -159,8 +516,8 @@ void Device::createLogicalDevice() {
 
   createInfo.pEnabledFeatures = &deviceFeatures;
   createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+      static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation
   // layers have been deprecated
@@ -172,13 +529,36 @@ void Device::createLogicalDevice() {
     createInfo.enabledLayerCount = 0;
   }
 
-  if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device_) !=
+  if (vkCreateDevice(physicalDevice, &createInfo, allocator(), &device_) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create logical device!");
   }
+  loadDeviceCommands(device_);
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+  // the loader resolved both the core and the extension commands
+  if (dynamicRenderingSupported) {
+    cmdBeginRendering_ =
+        dynamicRenderingCore ? vkCmdBeginRendering : vkCmdBeginRenderingKHR;
+    cmdEndRendering_ =
+        dynamicRenderingCore ? vkCmdEndRendering : vkCmdEndRenderingKHR;
+  }
+
+  if (extendedDynamicStateSupported) {
+    bool core = extendedDynamicStateCore;
+    cmdSetCullMode_ = core ? vkCmdSetCullMode : vkCmdSetCullModeEXT;
+    cmdSetFrontFace_ = core ? vkCmdSetFrontFace : vkCmdSetFrontFaceEXT;
+    cmdSetPrimitiveTopology_ =
+        core ? vkCmdSetPrimitiveTopology : vkCmdSetPrimitiveTopologyEXT;
+    cmdSetDepthTestEnable_ =
+        core ? vkCmdSetDepthTestEnable : vkCmdSetDepthTestEnableEXT;
+    cmdSetDepthWriteEnable_ =
+        core ? vkCmdSetDepthWriteEnable : vkCmdSetDepthWriteEnableEXT;
+    cmdSetDepthCompareOp_ =
+        core ? vkCmdSetDepthCompareOp : vkCmdSetDepthCompareOpEXT;
+  }
 }
 
 void Device::createCommandPool() {
@@ -190,14 +570,14 @@ void Device::createCommandPool() {
   poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
                    VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) !=
+  if (vkCreateCommandPool(device_, &poolInfo, allocator(), &commandPool) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
 }
 
 void Device::createSurface() {
-  window.createWindowSurface(instance, &surface_);
+  window.createWindowSurface(instance, allocator(), &surface_);
 }
 
 bool Device::isDeviceSuitable(VkPhysicalDevice device) {
@@ -237,7 +617,7 @@ void Device::setupDebugMessenger() {
   VkDebugUtilsMessengerCreateInfoEXT createInfo;
   populateDebugMessengerCreateInfo(createInfo);
   if (CreateDebugUtilsMessengerEXT(
-          instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+          instance, &createInfo, allocator(), &debugMessenger) != VK_SUCCESS) {
     throw std::runtime_error("failed to set up debug messenger!");
   }
 }
@@ -289,17 +669,17 @@ void Device::hasGlfwRequiredInstanceExtensions() {
   vkEnumerateInstanceExtensionProperties(
       nullptr, &extensionCount, extensions.data());
 
-  std::cout << "available extensions:" << std::endl;
+  LogMessage{LogSeverity::Debug} << "available extensions:";
   std::unordered_set<std::string> available;
   for (const auto &extension : extensions) {
-    std::cout << "\t" << extension.extensionName << std::endl;
+    LogMessage{LogSeverity::Debug} << "\t" << extension.extensionName;
     available.insert(extension.extensionName);
   }
 
-  std::cout << "required extensions:" << std::endl;
+  LogMessage{LogSeverity::Debug} << "required extensions:";
   auto requiredExtensions = getRequiredExtensions();
   for (const auto &required : requiredExtensions) {
-    std::cout << "\t" << required << std::endl;
+    LogMessage{LogSeverity::Debug} << "\t" << required;
     if (available.find(required) == available.end()) {
       throw std::runtime_error("Missing required glfw extension");
     }
@@ -325,6 +705,59 @@ bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool Device::isDeviceExtensionAvailable(const char *extensionName) {
+  return hasDeviceExtension(physicalDevice, extensionName);
+}
+
+bool Device::isExtendedDynamicStateFeatureAvailable() {
+  if (properties.apiVersion < VK_API_VERSION_1_1 ||
+      !isDeviceExtensionAvailable(
+          VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+    return false;
+  }
+
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures =
+      {};
+  extendedDynamicStateFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &extendedDynamicStateFeatures;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+  return extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+}
+
+bool Device::isDescriptorIndexingFeatureAvailable() {
+  if (properties.apiVersion < VK_API_VERSION_1_1) {
+    return false;
+  }
+  if (properties.apiVersion < VK_API_VERSION_1_2 &&
+      !isDeviceExtensionAvailable(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+    return false;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {};
+  descriptorIndexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &descriptorIndexingFeatures;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+  return descriptorIndexingFeatures.runtimeDescriptorArray &&
+         descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+         descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+         descriptorIndexingFeatures
+             .descriptorBindingSampledImageUpdateAfterBind &&
+         descriptorIndexingFeatures
+             .descriptorBindingStorageBufferUpdateAfterBind &&
+         descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+         descriptorIndexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+}
+
 QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -388,20 +821,25 @@ VkFormat Device::findSupportedFormat(const std::vector<VkFormat> &candidates,
                                      VkImageTiling tiling,
                                      VkFormatFeatureFlags features) {
   for (VkFormat format : candidates) {
-    VkFormatProperties props;
-    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
-
-    if (tiling == VK_IMAGE_TILING_LINEAR &&
-        (props.linearTilingFeatures & features) == features) {
-      return format;
-    } else if (tiling == VK_IMAGE_TILING_OPTIMAL &&
-               (props.optimalTilingFeatures & features) == features) {
+    if (isFormatSupported(format, tiling, features)) {
       return format;
     }
   }
   throw std::runtime_error("failed to find supported format!");
 }
 
+bool Device::isFormatSupported(VkFormat format,
+                               VkImageTiling tiling,
+                               VkFormatFeatureFlags features) {
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+  if (tiling == VK_IMAGE_TILING_LINEAR) {
+    return (props.linearTilingFeatures & features) == features;
+  }
+  return (props.optimalTilingFeatures & features) == features;
+}
+
 uint32_t Device::findMemoryType(uint32_t typeFilter,
                                 VkMemoryPropertyFlags properties) {
   VkPhysicalDeviceMemoryProperties memProperties;
@@ -416,6 +854,51 @@ uint32_t Device::findMemoryType(uint32_t typeFilter,
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool Device::hasMemoryType(uint32_t typeFilter,
+                           VkMemoryPropertyFlags properties) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags &
+                                    properties) == properties) {
+      return true;
+    }
+  }
+  return false;
+}
+
+MemoryBudget Device::getDeviceLocalMemoryBudget() {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+  budgetProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  VkPhysicalDeviceMemoryProperties2 memProperties{};
+  memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  if (memoryBudgetSupported) {
+    memProperties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties);
+  } else {
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice,
+                                        &memProperties.memoryProperties);
+  }
+
+  MemoryBudget budget;
+  const auto &heaps = memProperties.memoryProperties.memoryHeaps;
+  for (uint32_t i = 0; i < memProperties.memoryProperties.memoryHeapCount;
+       i++) {
+    if (!(heaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+      continue;
+    }
+    if (memoryBudgetSupported) {
+      budget.budget += budgetProperties.heapBudget[i];
+      budget.usage += budgetProperties.heapUsage[i];
+    } else {
+      budget.budget += heaps[i].size;
+    }
+  }
+  return budget;
+}
+
 void Device::createBuffer(VkDeviceSize size,
                           VkBufferUsageFlags usage,
                           VkMemoryPropertyFlags properties,
@@ -427,7 +910,8 @@ void Device::createBuffer(VkDeviceSize size,
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-  if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+  if (vkCreateBuffer(device_, &bufferInfo, allocator(), &buffer) !=
+      VK_SUCCESS) {
     throw std::runtime_error("failed to create vertex buffer!");
   }
 
@@ -440,7 +924,7 @@ void Device::createBuffer(VkDeviceSize size,
   allocInfo.memoryTypeIndex =
       findMemoryType(memRequirements.memoryTypeBits, properties);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) !=
+  if (vkAllocateMemory(device_, &allocInfo, allocator(), &bufferMemory) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to allocate vertex buffer memory!");
   }
@@ -527,7 +1011,7 @@ void Device::createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                  VkMemoryPropertyFlags properties,
                                  VkImage &image,
                                  VkDeviceMemory &imageMemory) {
-  if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+  if (vkCreateImage(device_, &imageInfo, allocator(), &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
 
@@ -540,7 +1024,7 @@ void Device::createImageWithInfo(const VkImageCreateInfo &imageInfo,
   allocInfo.memoryTypeIndex =
       findMemoryType(memRequirements.memoryTypeBits, properties);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) !=
+  if (vkAllocateMemory(device_, &allocInfo, allocator(), &imageMemory) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to allocate image memory!");
   }
@@ -550,4 +1034,43 @@ void Device::createImageWithInfo(const VkImageCreateInfo &imageInfo,
   }
 }
 
+void Device::cmdBeginRendering(VkCommandBuffer commandBuffer,
+                               const VkRenderingInfoKHR &renderingInfo) {
+  cmdBeginRendering_(commandBuffer, &renderingInfo);
+}
+
+void Device::cmdEndRendering(VkCommandBuffer commandBuffer) {
+  cmdEndRendering_(commandBuffer);
+}
+
+void Device::cmdSetCullMode(VkCommandBuffer commandBuffer,
+                            VkCullModeFlags cullMode) {
+  cmdSetCullMode_(commandBuffer, cullMode);
+}
+
+void Device::cmdSetFrontFace(VkCommandBuffer commandBuffer,
+                             VkFrontFace frontFace) {
+  cmdSetFrontFace_(commandBuffer, frontFace);
+}
+
+void Device::cmdSetPrimitiveTopology(VkCommandBuffer commandBuffer,
+                                     VkPrimitiveTopology topology) {
+  cmdSetPrimitiveTopology_(commandBuffer, topology);
+}
+
+void Device::cmdSetDepthTestEnable(VkCommandBuffer commandBuffer,
+                                   VkBool32 depthTestEnable) {
+  cmdSetDepthTestEnable_(commandBuffer, depthTestEnable);
+}
+
+void Device::cmdSetDepthWriteEnable(VkCommandBuffer commandBuffer,
+                                    VkBool32 depthWriteEnable) {
+  cmdSetDepthWriteEnable_(commandBuffer, depthWriteEnable);
+}
+
+void Device::cmdSetDepthCompareOp(VkCommandBuffer commandBuffer,
+                                  VkCompareOp depthCompareOp) {
+  cmdSetDepthCompareOp_(commandBuffer, depthCompareOp);
+}
+
 }  // namespace lve
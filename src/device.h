@@ -1,5 +1,8 @@
 #pragma once
 
+#include "deletion_queue.h"
+#include "host_allocator.h"
+#include "job_system.h"
 #include "window.h"
 
 // std lib headers
@@ -14,6 +17,12 @@ struct SwapChainSupportDetails {
   std::vector<VkPresentModeKHR> presentModes;
 };
 
+// Summed over the device-local heaps.
+struct MemoryBudget {
+  VkDeviceSize budget = 0;
+  VkDeviceSize usage = 0;
+};
+
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
@@ -44,18 +53,56 @@ class Device {
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  // pAllocator for every vkCreate*/vkDestroy* and vkAllocateMemory/
+  // vkFreeMemory call, so driver host allocations are tracked
+  const VkAllocationCallbacks *allocator() {
+    return hostAllocator.getCallbacks();
+  }
+  HostAllocator &getHostAllocator() { return hostAllocator; }
+  // Destructors of objects the GPU may still use push their Vulkan handles
+  // here instead of destroying them; the swapchain collects finished frames.
+  DeletionQueue &getDeletionQueue() { return deletionQueue; }
+  // the worker pool every subsystem schedules its parallel work on
+  JobSystem &getJobSystem() { return jobSystem; }
+  // Vulkan 1.3 or VK_KHR_dynamic_rendering; the rendering commands below are
+  // only valid when this is true
+  bool supportsDynamicRendering() { return dynamicRenderingSupported; }
+  // Vulkan 1.3 or VK_EXT_extended_dynamic_state; the cmdSet* commands below
+  // are only valid when this is true
+  bool supportsExtendedDynamicState() { return extendedDynamicStateSupported; }
+  bool supportsMemoryBudget() { return memoryBudgetSupported; }
+  // Vulkan 1.2 or VK_EXT_descriptor_indexing with the features bindless
+  // descriptor arrays need: runtime arrays, non-uniform indexing, partially
+  // bound and update-after-bind bindings
+  bool supportsDescriptorIndexing() { return descriptorIndexingSupported; }
+  // storage images declared without a format qualifier can be written
+  bool supportsStorageImageWriteWithoutFormat() {
+    return storageImageWriteWithoutFormatSupported;
+  }
+  // valid bits of timestamps written on the graphics queue, 0 when it has
+  // none; ticks are properties.limits.timestampPeriod nanoseconds apart
+  uint32_t getGraphicsTimestampValidBits() {
+    return graphicsTimestampValidBits;
+  }
 
   SwapChainSupportDetails getSwapChainSupport() {
     return querySwapChainSupport(physicalDevice);
   }
   uint32_t findMemoryType(uint32_t typeFilter,
                           VkMemoryPropertyFlags properties);
+  bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  // Current budget and process usage from VK_EXT_memory_budget; without it
+  // the budget is the heap size and the usage is unknown (0).
+  MemoryBudget getDeviceLocalMemoryBudget();
   QueueFamilyIndices findPhysicalQueueFamilies() {
     return findQueueFamilies(physicalDevice);
   }
   VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates,
                                VkImageTiling tiling,
                                VkFormatFeatureFlags features);
+  bool isFormatSupported(VkFormat format,
+                         VkImageTiling tiling,
+                         VkFormatFeatureFlags features);
 
   // Buffer Helper Functions
   void createBuffer(VkDeviceSize size,
@@ -77,7 +124,23 @@ class Device {
                            VkImage &image,
                            VkDeviceMemory &imageMemory);
 
+  void cmdBeginRendering(VkCommandBuffer commandBuffer,
+                         const VkRenderingInfoKHR &renderingInfo);
+  void cmdEndRendering(VkCommandBuffer commandBuffer);
+  void cmdSetCullMode(VkCommandBuffer commandBuffer, VkCullModeFlags cullMode);
+  void cmdSetFrontFace(VkCommandBuffer commandBuffer, VkFrontFace frontFace);
+  void cmdSetPrimitiveTopology(VkCommandBuffer commandBuffer,
+                               VkPrimitiveTopology topology);
+  void cmdSetDepthTestEnable(VkCommandBuffer commandBuffer,
+                             VkBool32 depthTestEnable);
+  void cmdSetDepthWriteEnable(VkCommandBuffer commandBuffer,
+                              VkBool32 depthWriteEnable);
+  void cmdSetDepthCompareOp(VkCommandBuffer commandBuffer,
+                            VkCompareOp depthCompareOp);
+
   VkPhysicalDeviceProperties properties;
+  // only filled in when supportsDescriptorIndexing()
+  VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{};
 
  private:
   void createInstance();
@@ -96,19 +159,43 @@ class Device {
       VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGlfwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isDeviceExtensionAvailable(const char *extensionName);
+  bool isExtendedDynamicStateFeatureAvailable();
+  bool isDescriptorIndexingFeatureAvailable();
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
+  // outlives every object created with its callbacks
+  HostAllocator hostAllocator;
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   Window &window;
   VkCommandPool commandPool;
+  DeletionQueue deletionQueue;
+  JobSystem jobSystem;
 
   VkDevice device_;
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
 
+  bool dynamicRenderingSupported = false;
+  PFN_vkCmdBeginRendering cmdBeginRendering_ = nullptr;
+  PFN_vkCmdEndRendering cmdEndRendering_ = nullptr;
+
+  bool memoryBudgetSupported = false;
+  bool descriptorIndexingSupported = false;
+  bool storageImageWriteWithoutFormatSupported = false;
+  uint32_t graphicsTimestampValidBits = 0;
+
+  bool extendedDynamicStateSupported = false;
+  PFN_vkCmdSetCullModeEXT cmdSetCullMode_ = nullptr;
+  PFN_vkCmdSetFrontFaceEXT cmdSetFrontFace_ = nullptr;
+  PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology_ = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable_ = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable_ = nullptr;
+  PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp_ = nullptr;
+
   const std::vector<const char *> validationLayers = {
       "VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {
@@ -0,0 +1,67 @@
+#include "frame_arena.h"
+
+// std lib headers
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+// threads are numbered on their first allocation from any frame arena
+static std::atomic<uint32_t> nextThreadIndex{0};
+static thread_local uint32_t threadIndex = nextThreadIndex.fetch_add(1);
+
+void LinearArena::reset() {
+  chunkIndex = 0;
+  chunkOffset = 0;
+  usedBytes = 0;
+}
+
+void *LinearArena::do_allocate(size_t bytes, size_t alignment) {
+  while (true) {
+    for (; chunkIndex < chunks.size(); chunkIndex++, chunkOffset = 0) {
+      auto &chunk = chunks[chunkIndex];
+      auto base = reinterpret_cast<uintptr_t>(chunk.data.get());
+      size_t offset =
+          ((base + chunkOffset + alignment - 1) & ~(alignment - 1)) - base;
+      if (offset + bytes <= chunk.size) {
+        chunkOffset = offset + bytes;
+        usedBytes += bytes;
+        return chunk.data.get() + offset;
+      }
+    }
+
+    // every chunk is full; later frames reuse the new one
+    size_t size = std::max(CHUNK_SIZE, bytes + alignment);
+    chunks.push_back({std::unique_ptr<std::byte[]>{new std::byte[size]}, size});
+    chunkAllocationCount++;
+  }
+}
+
+void FrameArena::beginFrame(int frameIndex) {
+  size_t frameBytes = 0;
+  uint64_t chunkAllocationCount = 0;
+  for (const auto &frame : frames) {
+    for (const auto &arena : frame) {
+      chunkAllocationCount += arena.getChunkAllocationCount();
+    }
+  }
+  for (auto &arena : frames[frameIndex]) {
+    frameBytes += arena.getUsedBytes();
+    arena.reset();
+  }
+
+  // what the frame last recorded in this slot used
+  statistics.lastFrameBytes = frameBytes;
+  statistics.peakFrameBytes = std::max(statistics.peakFrameBytes, frameBytes);
+  statistics.chunkAllocationCount = chunkAllocationCount;
+  currentFrame = frameIndex;
+}
+
+std::pmr::memory_resource *FrameArena::getResource() {
+  if (threadIndex >= MAX_THREADS) {
+    throw std::runtime_error("failed to use frame arena, too many threads!");
+  }
+  return &frames[currentFrame][threadIndex];
+}
+
+}  // namespace lve
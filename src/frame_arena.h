@@ -0,0 +1,95 @@
+#pragma once
+
+#include "swapchain.h"
+
+// std lib headers
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace lve {
+
+// Bump allocator over chunks that are kept when it is reset, so once it has
+// grown to what a frame needs, allocating from it never reaches the heap.
+// Deallocation is a no-op; everything is released at once by reset(). Not
+// thread-safe.
+class LinearArena : public std::pmr::memory_resource {
+ public:
+  static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+  LinearArena() = default;
+
+  LinearArena(const LinearArena &) = delete;
+  LinearArena &operator=(const LinearArena &) = delete;
+
+  void reset();
+
+  size_t getUsedBytes() const { return usedBytes; }
+  uint64_t getChunkAllocationCount() const { return chunkAllocationCount; }
+
+ private:
+  struct Chunk {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *pointer, size_t bytes, size_t alignment) override {}
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  std::vector<Chunk> chunks;
+  // the chunk allocations are bumped from, and how far
+  size_t chunkIndex = 0;
+  size_t chunkOffset = 0;
+  size_t usedBytes = 0;
+  uint64_t chunkAllocationCount = 0;
+};
+
+// Scratch memory for CPU data that lives no longer than the frame it was
+// allocated for: barrier arrays, draw lists and the like. Each frame slot has
+// one LinearArena per thread, so jobs allocate without contention, and a
+// slot's arenas are reset wholesale once its fence has signaled.
+//
+//   std::pmr::vector<VkImageMemoryBarrier> barriers{arena.getResource()};
+class FrameArena {
+ public:
+  // threads that may allocate from the same frame
+  static constexpr uint32_t MAX_THREADS = 64;
+
+  struct Statistics {
+    size_t lastFrameBytes = 0;
+    size_t peakFrameBytes = 0;
+    // chunks allocated from the heap so far; constant in the steady state
+    uint64_t chunkAllocationCount = 0;
+  };
+
+  FrameArena() = default;
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  // Call once per frame after the frame slot's fence has been waited on, and
+  // while no thread allocates from the arena.
+  void beginFrame(int frameIndex);
+
+  // the calling thread's arena for the frame being recorded
+  std::pmr::memory_resource *getResource();
+
+  const Statistics &getStatistics() const { return statistics; }
+
+ private:
+  using ThreadArenas = std::array<LinearArena, MAX_THREADS>;
+
+  std::array<ThreadArenas, SwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+  std::atomic<int> currentFrame{0};
+  Statistics statistics;
+};
+
+}  // namespace lve
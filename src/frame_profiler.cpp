@@ -0,0 +1,120 @@
+#include "frame_profiler.h"
+
+// std lib headers
+#include <stdexcept>
+
+namespace lve {
+
+FrameProfiler::FrameProfiler(Device &device) : device{device} {
+  uint32_t validBits = device.getGraphicsTimestampValidBits();
+  if (validBits > 0) {
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    createQueryPool();
+  }
+  intervalStart = std::chrono::steady_clock::now();
+  intervalCpuStart = std::clock();
+}
+
+FrameProfiler::~FrameProfiler() {
+  if (queryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  device.getDeletionQueue().push(
+      [device = device.device(),
+       allocator = device.allocator(),
+       queryPool = queryPool] {
+        vkDestroyQueryPool(device, queryPool, allocator);
+      });
+}
+
+void FrameProfiler::createQueryPool() {
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = 2 * SwapChain::MAX_FRAMES_IN_FLIGHT;
+
+  if (vkCreateQueryPool(device.device(),
+                        &poolInfo,
+                        device.allocator(),
+                        &queryPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+}
+
+void FrameProfiler::beginFrame(int frameIndex) {
+  frameCount++;
+  if (queryPool == VK_NULL_HANDLE) {
+    return;
+  }
+
+  if (slotsPending[frameIndex]) {
+    std::array<uint64_t, 2> timestamps{};
+    if (vkGetQueryPoolResults(device.device(),
+                              queryPool,
+                              2 * frameIndex,
+                              2,
+                              sizeof(timestamps),
+                              timestamps.data(),
+                              sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+      gpuNanoseconds +=
+          ticks * static_cast<double>(device.properties.limits.timestampPeriod);
+    }
+  }
+  slotsPending[frameIndex] = true;
+}
+
+void FrameProfiler::recordBegin(VkCommandBuffer commandBuffer, int frameIndex) {
+  recordingStart = std::chrono::steady_clock::now();
+  if (queryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  vkCmdResetQueryPool(commandBuffer, queryPool, 2 * frameIndex, 2);
+  vkCmdWriteTimestamp(commandBuffer,
+                      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      queryPool,
+                      2 * frameIndex);
+}
+
+void FrameProfiler::recordEnd(VkCommandBuffer commandBuffer, int frameIndex) {
+  if (queryPool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(commandBuffer,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queryPool,
+                        2 * frameIndex + 1);
+  }
+  recordingCount++;
+  recordingSeconds += std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - recordingStart)
+                          .count();
+}
+
+double FrameProfiler::getElapsedSeconds() const {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       intervalStart)
+      .count();
+}
+
+FrameProfiler::Statistics FrameProfiler::takeStatistics() {
+  Statistics statistics{};
+  statistics.frameCount = frameCount;
+  statistics.wallSeconds = getElapsedSeconds();
+  statistics.cpuSeconds =
+      static_cast<double>(std::clock() - intervalCpuStart) / CLOCKS_PER_SEC;
+  if (queryPool != VK_NULL_HANDLE) {
+    statistics.gpuSeconds = gpuNanoseconds * 1e-9;
+  }
+  statistics.recordingCount = recordingCount;
+  statistics.recordingSeconds = recordingSeconds;
+
+  intervalStart = std::chrono::steady_clock::now();
+  intervalCpuStart = std::clock();
+  frameCount = 0;
+  gpuNanoseconds = 0.0;
+  recordingCount = 0;
+  recordingSeconds = 0.0;
+  return statistics;
+}
+
+}  // namespace lve
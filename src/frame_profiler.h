@@ -0,0 +1,71 @@
+#pragma once
+
+#include "device.h"
+#include "swapchain.h"
+
+// std lib headers
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace lve {
+
+// CPU and GPU utilization over a reporting interval, to compare continuous
+// and reactive rendering.
+//
+// CPU time is the whole process's, every thread included. GPU time comes from
+// a pair of timestamps around each frame's command buffer, so it covers the
+// frames' own work rather than everything the GPU was busy with.
+class FrameProfiler {
+ public:
+  struct Statistics {
+    uint32_t frameCount = 0;
+    double wallSeconds = 0.0;
+    double cpuSeconds = 0.0;
+    // negative when the graphics queue cannot write timestamps
+    double gpuSeconds = -1.0;
+    // command buffers recorded, and the CPU time between their
+    // recordBegin() and recordEnd()
+    uint32_t recordingCount = 0;
+    double recordingSeconds = 0.0;
+  };
+
+  FrameProfiler(Device &device);
+  ~FrameProfiler();
+
+  FrameProfiler(const FrameProfiler &) = delete;
+  FrameProfiler &operator=(const FrameProfiler &) = delete;
+
+  // Call once per frame after the frame slot's fence has been waited on;
+  // collects the GPU time of the frame last submitted from the slot.
+  void beginFrame(int frameIndex);
+  // Around everything else the frame's command buffer records; also times
+  // the recording on the CPU. The queries are reset inside the command
+  // buffer, so it can be submitted again without recording it again.
+  void recordBegin(VkCommandBuffer commandBuffer, int frameIndex);
+  void recordEnd(VkCommandBuffer commandBuffer, int frameIndex);
+
+  double getElapsedSeconds() const;
+  // the interval since the previous call, or since construction
+  Statistics takeStatistics();
+
+ private:
+  void createQueryPool();
+
+  Device &device;
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  uint64_t timestampMask = 0;
+  // a frame with timestamps was submitted from the slot
+  std::array<bool, SwapChain::MAX_FRAMES_IN_FLIGHT> slotsPending{};
+
+  std::chrono::steady_clock::time_point intervalStart;
+  std::clock_t intervalCpuStart;
+  uint32_t frameCount = 0;
+  double gpuNanoseconds = 0.0;
+  std::chrono::steady_clock::time_point recordingStart;
+  uint32_t recordingCount = 0;
+  double recordingSeconds = 0.0;
+};
+
+}  // namespace lve
@@ -0,0 +1,255 @@
+#include "host_allocator.h"
+
+// std lib headers
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace lve {
+
+// Precedes every allocation handed to the driver, which only gives the
+// pointer back when freeing.
+struct alignas(16) AllocationHeader {
+  // what malloc returned, or the pool block
+  void *base;
+  size_t size;
+  uint32_t scope;
+  // SIZE_CLASS_COUNT when not pooled
+  uint32_t sizeClass;
+};
+
+static const char *scopeName(size_t scope) {
+  switch (scope) {
+    case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+      return "command";
+    case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+      return "object";
+    case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+      return "cache";
+    case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+      return "device";
+    case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:
+      return "instance";
+    default:
+      return "unknown";
+  }
+}
+
+static void raisePeak(std::atomic<uint64_t> &peak, uint64_t value) {
+  uint64_t current = peak.load(std::memory_order_relaxed);
+  while (current < value &&
+         !peak.compare_exchange_weak(
+             current, value, std::memory_order_relaxed)) {
+  }
+}
+
+HostAllocator::HostAllocator() {
+  callbacks.pUserData = this;
+  callbacks.pfnAllocation = allocationCallback;
+  callbacks.pfnReallocation = reallocationCallback;
+  callbacks.pfnFree = freeCallback;
+  callbacks.pfnInternalAllocation = internalAllocationCallback;
+  callbacks.pfnInternalFree = internalFreeCallback;
+}
+
+HostAllocator::~HostAllocator() {
+  for (auto &pool : pools) {
+    while (pool.slabs != nullptr) {
+      void *next = *static_cast<void **>(pool.slabs);
+      std::free(pool.slabs);
+      pool.slabs = next;
+    }
+  }
+}
+
+std::array<HostAllocator::ScopeStatistics, HostAllocator::SCOPE_COUNT>
+HostAllocator::getStatistics() const {
+  std::array<ScopeStatistics, SCOPE_COUNT> statistics{};
+  for (size_t i = 0; i < SCOPE_COUNT; i++) {
+    const auto &scope = counters[i];
+    auto &stats = statistics[i];
+    stats.allocationCount = scope.allocationCount.load();
+    stats.reallocationCount = scope.reallocationCount.load();
+    stats.freeCount = scope.freeCount.load();
+    stats.pooledCount = scope.pooledCount.load();
+    stats.liveBytes = scope.liveBytes.load();
+    stats.peakBytes = scope.peakBytes.load();
+    stats.internalAllocationCount = scope.internalAllocationCount.load();
+    stats.internalLiveBytes = scope.internalLiveBytes.load();
+    stats.internalPeakBytes = scope.internalPeakBytes.load();
+  }
+  return statistics;
+}
+
+void HostAllocator::exportStatistics(std::ostream &out) const {
+  auto statistics = getStatistics();
+  for (size_t i = 0; i < SCOPE_COUNT; i++) {
+    const auto &stats = statistics[i];
+    out << "host_alloc[" << scopeName(i) << "]:"
+        << " allocations=" << stats.allocationCount
+        << " reallocations=" << stats.reallocationCount
+        << " frees=" << stats.freeCount << " pooled=" << stats.pooledCount
+        << " live_bytes=" << stats.liveBytes
+        << " peak_bytes=" << stats.peakBytes
+        << " internal_allocations=" << stats.internalAllocationCount
+        << " internal_live_bytes=" << stats.internalLiveBytes
+        << " internal_peak_bytes=" << stats.internalPeakBytes << std::endl;
+  }
+}
+
+void *HostAllocator::allocationCallback(void *userData,
+                                        size_t size,
+                                        size_t alignment,
+                                        VkSystemAllocationScope scope) {
+  return static_cast<HostAllocator *>(userData)->allocate(
+      size, alignment, scope);
+}
+
+void *HostAllocator::reallocationCallback(void *userData,
+                                          void *original,
+                                          size_t size,
+                                          size_t alignment,
+                                          VkSystemAllocationScope scope) {
+  auto allocator = static_cast<HostAllocator *>(userData);
+  if (original == nullptr) {
+    return allocator->allocate(size, alignment, scope);
+  }
+  if (size == 0) {
+    allocator->free(original);
+    return nullptr;
+  }
+
+  allocator->counters[scope].reallocationCount++;
+  const auto *header = static_cast<const AllocationHeader *>(original) - 1;
+  void *memory = allocator->allocate(size, alignment, scope);
+  if (memory == nullptr) {
+    // the original stays valid on failure
+    return nullptr;
+  }
+  std::memcpy(memory, original, std::min(size, header->size));
+  allocator->free(original);
+  return memory;
+}
+
+void HostAllocator::freeCallback(void *userData, void *memory) {
+  static_cast<HostAllocator *>(userData)->free(memory);
+}
+
+void HostAllocator::internalAllocationCallback(void *userData,
+                                               size_t size,
+                                               VkInternalAllocationType type,
+                                               VkSystemAllocationScope scope) {
+  auto &scopeCounters = static_cast<HostAllocator *>(userData)->counters[scope];
+  scopeCounters.internalAllocationCount++;
+  raisePeak(scopeCounters.internalPeakBytes,
+            scopeCounters.internalLiveBytes.fetch_add(size) + size);
+}
+
+void HostAllocator::internalFreeCallback(void *userData,
+                                         size_t size,
+                                         VkInternalAllocationType type,
+                                         VkSystemAllocationScope scope) {
+  auto &scopeCounters = static_cast<HostAllocator *>(userData)->counters[scope];
+  scopeCounters.internalLiveBytes -= size;
+}
+
+void *HostAllocator::allocate(size_t size,
+                              size_t alignment,
+                              VkSystemAllocationScope scope) {
+  alignment = std::max(alignment, alignof(AllocationHeader));
+  size_t headerSize = sizeof(AllocationHeader);
+
+  void *base = nullptr;
+  std::byte *memory = nullptr;
+  uint32_t sizeClass = SIZE_CLASS_COUNT;
+  if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND &&
+      alignment == alignof(AllocationHeader)) {
+    for (uint32_t i = 0; i < SIZE_CLASS_COUNT; i++) {
+      if (headerSize + size <= MIN_BLOCK_SIZE << i) {
+        sizeClass = i;
+        break;
+      }
+    }
+  }
+
+  if (sizeClass < SIZE_CLASS_COUNT) {
+    base = allocateFromPool(sizeClass);
+    if (base == nullptr) {
+      return nullptr;
+    }
+    memory = static_cast<std::byte *>(base) + headerSize;
+  } else {
+    base = std::malloc(headerSize + size + alignment);
+    if (base == nullptr) {
+      return nullptr;
+    }
+    auto address = reinterpret_cast<uintptr_t>(base) + headerSize;
+    address = (address + alignment - 1) & ~(alignment - 1);
+    memory = reinterpret_cast<std::byte *>(address);
+  }
+
+  auto header = reinterpret_cast<AllocationHeader *>(memory) - 1;
+  header->base = base;
+  header->size = size;
+  header->scope = scope;
+  header->sizeClass = sizeClass;
+
+  auto &scopeCounters = counters[scope];
+  scopeCounters.allocationCount++;
+  if (sizeClass < SIZE_CLASS_COUNT) {
+    scopeCounters.pooledCount++;
+  }
+  raisePeak(scopeCounters.peakBytes,
+            scopeCounters.liveBytes.fetch_add(size) + size);
+  return memory;
+}
+
+void HostAllocator::free(void *memory) {
+  if (memory == nullptr) {
+    return;
+  }
+
+  const auto *header = static_cast<const AllocationHeader *>(memory) - 1;
+  auto &scopeCounters = counters[header->scope];
+  scopeCounters.freeCount++;
+  scopeCounters.liveBytes -= header->size;
+
+  if (header->sizeClass < SIZE_CLASS_COUNT) {
+    freeToPool(header->base, header->sizeClass);
+  } else {
+    std::free(header->base);
+  }
+}
+
+void *HostAllocator::allocateFromPool(size_t sizeClass) {
+  auto &pool = pools[sizeClass];
+  std::lock_guard<std::mutex> lock{pool.mutex};
+  if (pool.freeList == nullptr) {
+    // the first block of a slab links the slabs together
+    size_t blockSize = MIN_BLOCK_SIZE << sizeClass;
+    auto slab = static_cast<std::byte *>(std::malloc(SLAB_SIZE));
+    if (slab == nullptr) {
+      return nullptr;
+    }
+    *reinterpret_cast<void **>(slab) = pool.slabs;
+    pool.slabs = slab;
+    for (size_t offset = blockSize; offset + blockSize <= SLAB_SIZE;
+         offset += blockSize) {
+      *reinterpret_cast<void **>(slab + offset) = pool.freeList;
+      pool.freeList = slab + offset;
+    }
+  }
+
+  void *block = pool.freeList;
+  pool.freeList = *static_cast<void **>(block);
+  return block;
+}
+
+void HostAllocator::freeToPool(void *block, size_t sizeClass) {
+  auto &pool = pools[sizeClass];
+  std::lock_guard<std::mutex> lock{pool.mutex};
+  *static_cast<void **>(block) = pool.freeList;
+  pool.freeList = block;
+}
+
+}  // namespace lve
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "vulkan_loader.h"
+
+// std lib headers
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+namespace lve {
+
+// VkAllocationCallbacks that account for every host allocation the driver
+// and loader make, per VkSystemAllocationScope, so driver-side churn shows up
+// in long runs. Command-scope allocations, which live no longer than the
+// command that made them, are small and frequent; they come from size-class
+// pools instead of malloc.
+//
+// Objects must be destroyed with the same callbacks they were created with,
+// so pass getCallbacks() (Device::allocator()) to every vkCreate*, vkDestroy*,
+// vkAllocateMemory and vkFreeMemory.
+class HostAllocator {
+ public:
+  static constexpr size_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+  // block sizes of the pools, including the allocation header
+  static constexpr size_t MIN_BLOCK_SIZE = 64;
+  static constexpr size_t SIZE_CLASS_COUNT = 5;
+  static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+  struct ScopeStatistics {
+    // allocations include those made by reallocations
+    uint64_t allocationCount = 0;
+    uint64_t reallocationCount = 0;
+    uint64_t freeCount = 0;
+    // allocations served from the pools
+    uint64_t pooledCount = 0;
+    uint64_t liveBytes = 0;
+    uint64_t peakBytes = 0;
+    // allocations the driver made itself and only reported, e.g. executable
+    // memory for shaders
+    uint64_t internalAllocationCount = 0;
+    uint64_t internalLiveBytes = 0;
+    uint64_t internalPeakBytes = 0;
+  };
+
+  HostAllocator();
+  ~HostAllocator();
+
+  HostAllocator(const HostAllocator &) = delete;
+  HostAllocator &operator=(const HostAllocator &) = delete;
+
+  const VkAllocationCallbacks *getCallbacks() const { return &callbacks; }
+
+  std::array<ScopeStatistics, SCOPE_COUNT> getStatistics() const;
+  // one key=value line per scope, e.g. for comparing runs
+  void exportStatistics(std::ostream &out) const;
+
+ private:
+  struct Counters {
+    std::atomic<uint64_t> allocationCount{0};
+    std::atomic<uint64_t> reallocationCount{0};
+    std::atomic<uint64_t> freeCount{0};
+    std::atomic<uint64_t> pooledCount{0};
+    std::atomic<uint64_t> liveBytes{0};
+    std::atomic<uint64_t> peakBytes{0};
+    std::atomic<uint64_t> internalAllocationCount{0};
+    std::atomic<uint64_t> internalLiveBytes{0};
+    std::atomic<uint64_t> internalPeakBytes{0};
+  };
+
+  // Free blocks of one size class, linked through their first bytes. Slabs
+  // are only released with the allocator.
+  struct Pool {
+    std::mutex mutex;
+    void *freeList = nullptr;
+    void *slabs = nullptr;
+  };
+
+  static VKAPI_ATTR void *VKAPI_CALL allocationCallback(
+      void *userData,
+      size_t size,
+      size_t alignment,
+      VkSystemAllocationScope scope);
+  static VKAPI_ATTR void *VKAPI_CALL
+  reallocationCallback(void *userData,
+                       void *original,
+                       size_t size,
+                       size_t alignment,
+                       VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL freeCallback(void *userData,
+                                                 void *memory);
+  static VKAPI_ATTR void VKAPI_CALL
+  internalAllocationCallback(void *userData,
+                             size_t size,
+                             VkInternalAllocationType type,
+                             VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL
+  internalFreeCallback(void *userData,
+                       size_t size,
+                       VkInternalAllocationType type,
+                       VkSystemAllocationScope scope);
+
+  void *allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+  void free(void *memory);
+  void *allocateFromPool(size_t sizeClass);
+  void freeToPool(void *block, size_t sizeClass);
+
+  VkAllocationCallbacks callbacks{};
+  std::array<Counters, SCOPE_COUNT> counters;
+  std::array<Pool, SIZE_CLASS_COUNT> pools;
+};
+
+}  // namespace lve
@@ -0,0 +1,245 @@
+#include "job_system.h"
+
+// std lib headers
+#include <algorithm>
+#include <string>
+
+// posix headers
+#include <pthread.h>
+
+namespace lve {
+
+// the pool and worker index of the calling thread; no pool for threads
+// outside every pool
+static thread_local const JobSystem *currentSystem = nullptr;
+static thread_local uint32_t currentWorker = 0;
+
+JobSystem::JobSystem(Hooks hooks, uint32_t workerCount)
+    : hooks{std::move(hooks)} {
+  if (workerCount == 0) {
+    // the threads that schedule jobs run them too while they wait
+    workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  }
+
+  for (uint32_t i = 0; i < workerCount; i++) {
+    queues.push_back(std::make_unique<JobQueue>());
+  }
+  for (uint32_t i = 0; i < workerCount; i++) {
+    workers.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock{wakeMutex};
+    stopping = true;
+  }
+  wakeCondition.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void JobSystem::schedule(JobCounter &counter,
+                         std::function<void()> function,
+                         const char *name) {
+  Job *job = new Job{std::move(function), &counter, name};
+  counter.pending.fetch_add(1, std::memory_order_relaxed);
+  // counted before it can be taken, so the count never drops below zero
+  queuedCount.fetch_add(1);
+
+  if (currentSystem == this) {
+    if (!queues[currentWorker]->push(job)) {
+      queuedCount.fetch_sub(1);
+      run(job);
+      return;
+    }
+  } else {
+    std::lock_guard<std::mutex> lock{sharedMutex};
+    sharedJobs.push_back(job);
+  }
+  notifyWorkers();
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  while (!counter.isDone()) {
+    if (Job *job = findJob()) {
+      run(job);
+    } else {
+      // the remaining jobs are running elsewhere
+      std::this_thread::yield();
+    }
+  }
+
+  std::exception_ptr exception;
+  {
+    std::lock_guard<std::mutex> lock{counter.exceptionMutex};
+    std::swap(exception, counter.exception);
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+void JobSystem::parallelFor(size_t begin,
+                            size_t end,
+                            size_t grainSize,
+                            const std::function<void(size_t, size_t)> &function,
+                            const char *name) {
+  grainSize = std::max<size_t>(grainSize, 1);
+  JobCounter counter;
+  for (size_t first = begin; first < end; first += grainSize) {
+    size_t last = std::min(first + grainSize, end);
+    schedule(
+        counter, [&function, first, last] { function(first, last); }, name);
+  }
+  wait(counter);
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex) {
+  currentSystem = this;
+  currentWorker = workerIndex;
+  std::string threadName = "lve-worker-" + std::to_string(workerIndex);
+  pthread_setname_np(pthread_self(), threadName.c_str());
+  if (hooks.workerStarted) {
+    hooks.workerStarted(workerIndex);
+  }
+
+  while (true) {
+    if (Job *job = findJob()) {
+      run(job);
+      continue;
+    }
+
+    // Schedulers count the job before checking for sleepers and workers count
+    // themselves before checking for jobs, so one always sees the other.
+    std::unique_lock<std::mutex> lock{wakeMutex};
+    sleepingCount.fetch_add(1);
+    wakeCondition.wait(lock, [this] {
+      return stopping || queuedCount.load() > 0;
+    });
+    sleepingCount.fetch_sub(1);
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+JobSystem::Job *JobSystem::findJob() {
+  Job *job = nullptr;
+  uint32_t queueCount = static_cast<uint32_t>(queues.size());
+  bool isWorker = currentSystem == this;
+  if (isWorker) {
+    job = queues[currentWorker]->pop();
+  }
+
+  // start at a different victim per thread so thieves spread out
+  uint32_t start = isWorker ? currentWorker + 1 : 0;
+  for (uint32_t i = 0; job == nullptr && i < queueCount; i++) {
+    uint32_t victim = (start + i) % queueCount;
+    if (!isWorker || victim != currentWorker) {
+      job = queues[victim]->steal();
+    }
+  }
+
+  if (job == nullptr) {
+    std::lock_guard<std::mutex> lock{sharedMutex};
+    if (!sharedJobs.empty()) {
+      job = sharedJobs.front();
+      sharedJobs.pop_front();
+    }
+  }
+
+  if (job != nullptr) {
+    queuedCount.fetch_sub(1);
+  }
+  return job;
+}
+
+void JobSystem::run(Job *job) {
+  if (hooks.jobBegin) {
+    hooks.jobBegin(job->name);
+  }
+  try {
+    job->function();
+  } catch (...) {
+    std::lock_guard<std::mutex> lock{job->counter->exceptionMutex};
+    if (!job->counter->exception) {
+      job->counter->exception = std::current_exception();
+    }
+  }
+  if (hooks.jobEnd) {
+    hooks.jobEnd(job->name);
+  }
+
+  JobCounter *counter = job->counter;
+  delete job;
+  counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::notifyWorkers() {
+  if (sleepingCount.load() > 0) {
+    // taking the lock orders this after a worker's check of queuedCount
+    { std::lock_guard<std::mutex> lock{wakeMutex}; }
+    wakeCondition.notify_one();
+  }
+}
+
+bool JobSystem::JobQueue::push(Job *job) {
+  int64_t b = bottom.load(std::memory_order_relaxed);
+  int64_t t = top.load(std::memory_order_acquire);
+  if (b - t >= static_cast<int64_t>(QUEUE_CAPACITY)) {
+    return false;
+  }
+  jobs[b & MASK].store(job, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+JobSystem::Job *JobSystem::JobQueue::pop() {
+  int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = top.load(std::memory_order_relaxed);
+
+  if (t > b) {
+    // empty
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  Job *job = jobs[b & MASK].load(std::memory_order_relaxed);
+  if (t == b) {
+    // the last job, which a thief may be taking at the same time
+    if (!top.compare_exchange_strong(t,
+                                     t + 1,
+                                     std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      job = nullptr;
+    }
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+JobSystem::Job *JobSystem::JobQueue::steal() {
+  int64_t t = top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = bottom.load(std::memory_order_acquire);
+  if (t >= b) {
+    return nullptr;
+  }
+
+  Job *job = jobs[t & MASK].load(std::memory_order_relaxed);
+  if (!top.compare_exchange_strong(t,
+                                   t + 1,
+                                   std::memory_order_seq_cst,
+                                   std::memory_order_relaxed)) {
+    // lost the race to another thief or the owner
+    return nullptr;
+  }
+  return job;
+}
+
+}  // namespace lve
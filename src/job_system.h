@@ -0,0 +1,133 @@
+#pragma once
+
+// std lib headers
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lve {
+
+// Tracks a group of jobs so the thread that forked them can join them.
+// Counters may be reused once waited on.
+class JobCounter {
+ public:
+  JobCounter() = default;
+
+  JobCounter(const JobCounter &) = delete;
+  JobCounter &operator=(const JobCounter &) = delete;
+
+  bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+ private:
+  friend class JobSystem;
+
+  std::atomic<uint32_t> pending{0};
+  // the first exception thrown by one of the jobs, rethrown by wait()
+  std::mutex exceptionMutex;
+  std::exception_ptr exception;
+};
+
+// Work-stealing scheduler shared by every subsystem, with one worker per core
+// besides the calling thread.
+//
+// Each worker owns a Chase-Lev deque: it pushes and pops the jobs it forks at
+// the bottom, newest first while they are still hot in cache, and idle
+// workers steal the oldest ones from the top. Threads outside the pool hand
+// their jobs over through a shared queue. Waiting on a counter runs other
+// jobs instead of blocking, so jobs may fork and join jobs of their own.
+class JobSystem {
+ public:
+  // must be a power of two; a worker whose deque is full runs the job inline
+  static constexpr uint32_t QUEUE_CAPACITY = 4096;
+
+  struct Hooks {
+    // called on each worker before it runs any job, after it was named
+    // "lve-worker-<index>"
+    std::function<void(uint32_t workerIndex)> workerStarted;
+    // around every job, e.g. to open and close profiler scopes
+    std::function<void(const char *name)> jobBegin;
+    std::function<void(const char *name)> jobEnd;
+  };
+
+  // workerCount 0 sizes the pool to the machine's cores
+  JobSystem(Hooks hooks = {}, uint32_t workerCount = 0);
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  uint32_t getWorkerCount() const {
+    return static_cast<uint32_t>(workers.size());
+  }
+
+  // name must outlive the job
+  void schedule(JobCounter &counter,
+                std::function<void()> function,
+                const char *name = "job");
+  // Runs jobs until every job scheduled on the counter has finished, then
+  // rethrows the first exception any of them threw.
+  void wait(JobCounter &counter);
+
+  // Calls function(first, last) over consecutive subranges of [begin, end)
+  // of at most grainSize elements, in parallel, and returns once all are
+  // done.
+  void parallelFor(size_t begin,
+                   size_t end,
+                   size_t grainSize,
+                   const std::function<void(size_t, size_t)> &function,
+                   const char *name = "parallel for");
+
+ private:
+  struct Job {
+    std::function<void()> function;
+    JobCounter *counter;
+    const char *name;
+  };
+
+  // Chase-Lev work-stealing deque; push and pop belong to the owning worker,
+  // steal may be called from any thread.
+  class JobQueue {
+   public:
+    bool push(Job *job);
+    Job *pop();
+    Job *steal();
+
+   private:
+    static constexpr int64_t MASK = QUEUE_CAPACITY - 1;
+
+    std::atomic<int64_t> top{0};
+    std::atomic<int64_t> bottom{0};
+    std::array<std::atomic<Job *>, QUEUE_CAPACITY> jobs{};
+  };
+
+  void workerLoop(uint32_t workerIndex);
+  // the calling worker's own queue first, then the others', then the shared
+  // one
+  Job *findJob();
+  void run(Job *job);
+  void notifyWorkers();
+
+  Hooks hooks;
+  std::vector<std::unique_ptr<JobQueue>> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex sharedMutex;
+  std::deque<Job *> sharedJobs;
+
+  // queued but not yet taken by any thread; idle workers sleep while it is 0
+  std::atomic<uint32_t> queuedCount{0};
+  std::atomic<uint32_t> sleepingCount{0};
+  std::mutex wakeMutex;
+  std::condition_variable wakeCondition;
+  std::atomic<bool> stopping{false};
+};
+
+}  // namespace lve
@@ -0,0 +1,290 @@
+#include "logger.h"
+
+// std lib headers
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// posix headers
+#include <pthread.h>
+
+namespace lve {
+
+// rate slots looked at for an ID before giving up on limiting it
+static constexpr size_t MAX_RATE_PROBES = 8;
+
+static const char *severityName(LogSeverity severity) {
+  switch (severity) {
+    case LogSeverity::Debug:
+      return "debug";
+    case LogSeverity::Info:
+      return "info";
+    case LogSeverity::Warning:
+      return "warning";
+    case LogSeverity::Error:
+      return "error";
+  }
+  return "unknown";
+}
+
+// FNV-1a, never 0 so it cannot be mistaken for a missing ID
+static uint32_t hashText(std::string_view text) {
+  uint32_t hash = 2166136261u;
+  for (char c : text) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  return hash != 0 ? hash : 1;
+}
+
+Logger &Logger::get() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger() {
+  for (size_t i = 0; i < CAPACITY; i++) {
+    entries[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  if (const char *level = std::getenv("LVE_LOG_LEVEL")) {
+    for (auto severity : {LogSeverity::Debug,
+                          LogSeverity::Info,
+                          LogSeverity::Warning,
+                          LogSeverity::Error}) {
+      if (std::strcmp(level, severityName(severity)) == 0) {
+        minSeverity = severity;
+      }
+    }
+  }
+  if (const char *rate = std::getenv("LVE_LOG_RATE")) {
+    rateLimit = static_cast<uint32_t>(std::strtoul(rate, nullptr, 10));
+  }
+
+  thread = std::thread{&Logger::flushLoop, this};
+}
+
+Logger::~Logger() {
+  {
+    std::lock_guard<std::mutex> lock{flushMutex};
+    stopping = true;
+  }
+  flushCondition.notify_one();
+  thread.join();
+}
+
+uint64_t Logger::currentWindow() {
+  return std::chrono::steady_clock::now().time_since_epoch() / RATE_WINDOW + 1;
+}
+
+bool Logger::admit(uint32_t id) {
+  uint32_t limit = rateLimit.load(std::memory_order_relaxed);
+  if (limit == 0) {
+    return true;
+  }
+
+  uint64_t window = currentWindow();
+  for (size_t probe = 0; probe < MAX_RATE_PROBES; probe++) {
+    auto &slot = rateSlots[(id + probe) % RATE_SLOT_COUNT];
+    uint32_t slotId = slot.id.load(std::memory_order_relaxed);
+    if (slotId == 0 &&
+        slot.id.compare_exchange_strong(
+            slotId, id, std::memory_order_relaxed)) {
+      slotId = id;
+    }
+    if (slotId != id) {
+      continue;
+    }
+
+    uint64_t slotWindow = slot.window.load(std::memory_order_relaxed);
+    if (slotWindow != window &&
+        slot.window.compare_exchange_strong(
+            slotWindow, window, std::memory_order_relaxed)) {
+      slot.count.store(0, std::memory_order_relaxed);
+    }
+    if (slot.count.fetch_add(1, std::memory_order_relaxed) < limit) {
+      return true;
+    }
+    slot.suppressedCount.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  // too many distinct IDs at once
+  return true;
+}
+
+size_t Logger::findRateSlot(uint32_t id) const {
+  for (size_t probe = 0; probe < MAX_RATE_PROBES; probe++) {
+    size_t index = (id + probe) % RATE_SLOT_COUNT;
+    if (rateSlots[index].id.load(std::memory_order_relaxed) == id) {
+      return index;
+    }
+  }
+  return RATE_SLOT_COUNT;
+}
+
+void Logger::push(LogSeverity severity, uint32_t id, std::string_view text) {
+  if (!isEnabled(severity)) {
+    return;
+  }
+  if (id == 0) {
+    id = hashText(text);
+  }
+  if (!admit(id)) {
+    return;
+  }
+
+  // claim a free slot; the flusher frees them in order
+  size_t position = enqueuePosition.load(std::memory_order_relaxed);
+  Entry *entry;
+  while (true) {
+    entry = &entries[position % CAPACITY];
+    size_t sequence = entry->sequence.load(std::memory_order_acquire);
+    if (sequence == position) {
+      if (enqueuePosition.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (sequence < position) {
+      // the flusher has not caught up
+      droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+  }
+
+  entry->severity = severity;
+  entry->id = id;
+  entry->length =
+      static_cast<uint32_t>(std::min(text.size(), MAX_MESSAGE_LENGTH));
+  std::memcpy(entry->text, text.data(), entry->length);
+  entry->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Logger::flush() {
+  size_t target = enqueuePosition.load(std::memory_order_relaxed);
+  std::unique_lock<std::mutex> lock{flushMutex};
+  flushRequested = true;
+  flushCondition.notify_one();
+  flushedCondition.wait(
+      lock, [&] { return flushedPosition >= target || stopping; });
+}
+
+void Logger::flushLoop() {
+  pthread_setname_np(pthread_self(), "lve-logger");
+  std::unique_lock<std::mutex> lock{flushMutex};
+  while (true) {
+    flushCondition.wait_for(
+        lock, FLUSH_INTERVAL, [this] { return flushRequested || stopping; });
+    bool stop = stopping;
+    flushRequested = false;
+    lock.unlock();
+
+    drain();
+    reportSuppressed(stop);
+    uint64_t dropped = droppedCount.load(std::memory_order_relaxed);
+    if (dropped != reportedDroppedCount) {
+      std::cerr << "[warning] log buffer full, dropped "
+                << dropped - reportedDroppedCount << " messages\n";
+      reportedDroppedCount = dropped;
+    }
+    std::cout.flush();
+    std::cerr.flush();
+
+    lock.lock();
+    flushedPosition = dequeuePosition;
+    flushedCondition.notify_all();
+    if (stop) {
+      return;
+    }
+  }
+}
+
+void Logger::drain() {
+  while (true) {
+    auto &entry = entries[dequeuePosition % CAPACITY];
+    if (entry.sequence.load(std::memory_order_acquire) !=
+        dequeuePosition + 1) {
+      // empty, or the producer is still copying its message
+      return;
+    }
+    write(entry.severity, entry.id, {entry.text, entry.length});
+    entry.sequence.store(dequeuePosition + CAPACITY, std::memory_order_release);
+    dequeuePosition++;
+  }
+}
+
+void Logger::write(LogSeverity severity, uint32_t id, std::string_view text) {
+  size_t index = findRateSlot(id);
+  if (index < RATE_SLOT_COUNT) {
+    auto &sample = samples[index];
+    sample.id = id;
+    sample.severity = severity;
+    sample.length = static_cast<uint32_t>(std::min(text.size(), SAMPLE_LENGTH));
+    std::memcpy(sample.text, text.data(), sample.length);
+  }
+
+  auto &out = severity >= LogSeverity::Warning ? std::cerr : std::cout;
+  out << '[' << severityName(severity) << "] " << text << '\n';
+}
+
+void Logger::reportSuppressed(bool windowsEnded) {
+  uint64_t window = currentWindow();
+  for (size_t index = 0; index < RATE_SLOT_COUNT; index++) {
+    auto &slot = rateSlots[index];
+    uint32_t id = slot.id.load(std::memory_order_relaxed);
+    uint64_t slotWindow = slot.window.load(std::memory_order_relaxed);
+    if (id == 0 || (!windowsEnded && slotWindow == window)) {
+      continue;
+    }
+
+    uint32_t suppressedCount =
+        slot.suppressedCount.exchange(0, std::memory_order_relaxed);
+    if (suppressedCount > 0) {
+      // a slot handed to a new ID keeps the old sample until it is written
+      const auto &sample = samples[index];
+      bool sampled = sample.id == id;
+      LogSeverity severity = sampled ? sample.severity : LogSeverity::Warning;
+      auto &out = severity >= LogSeverity::Warning ? std::cerr : std::cout;
+      out << '[' << severityName(severity) << "] suppressed "
+          << suppressedCount << " more like: "
+          << (sampled ? std::string_view{sample.text, sample.length} : "?")
+          << '\n';
+    } else if (slotWindow + 1 < window) {
+      // quiet for a whole window; the slot can go to another ID
+      slot.id.compare_exchange_strong(id, 0, std::memory_order_relaxed);
+    }
+  }
+}
+
+LogMessage::LogMessage(LogSeverity severity, uint32_t id)
+    : severity{severity}, id{id}, enabled{Logger::get().isEnabled(severity)} {}
+
+LogMessage::~LogMessage() {
+  if (enabled) {
+    Logger::get().push(severity, id, {buffer.data(), length});
+  }
+}
+
+LogMessage &LogMessage::operator<<(std::string_view text) {
+  if (enabled) {
+    size_t count = std::min(text.size(), buffer.size() - length);
+    std::memcpy(buffer.data() + length, text.data(), count);
+    length += count;
+  }
+  return *this;
+}
+
+LogMessage &LogMessage::operator<<(double value) {
+  if (!enabled) {
+    return *this;
+  }
+  // what std::ostream prints by default
+  char digits[32];
+  int count = std::snprintf(digits, sizeof(digits), "%g", value);
+  return *this << std::string_view{
+             digits, std::min(static_cast<size_t>(count), sizeof(digits) - 1)};
+}
+
+}  // namespace lve
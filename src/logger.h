@@ -0,0 +1,181 @@
+#pragma once
+
+// std lib headers
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+namespace lve {
+
+enum class LogSeverity : uint8_t { Debug, Info, Warning, Error };
+
+// Process-wide sink for diagnostics, safe to use from any thread, including
+// the driver's. Producers copy messages into a lock-free ring buffer and
+// return; a background thread writes them out, so logging never blocks. When
+// the ring is full, messages are dropped and counted instead.
+//
+// Messages with the same ID, or the same text when they have none, are rate
+// limited before they take up space in the ring: at most getRateLimit() of
+// them are written per second, and the rest are summarized once the second
+// is over.
+//
+// LVE_LOG_LEVEL (debug, info, warning or error) sets the lowest severity
+// written, info by default, and LVE_LOG_RATE the limit per ID, 0 for none.
+class Logger {
+ public:
+  static constexpr size_t CAPACITY = 256;
+  static constexpr size_t MAX_MESSAGE_LENGTH = 2048;
+  static constexpr uint32_t DEFAULT_RATE_LIMIT = 10;
+  static constexpr std::chrono::milliseconds FLUSH_INTERVAL{50};
+  static constexpr std::chrono::seconds RATE_WINDOW{1};
+  // IDs rate limited at once; beyond that, messages are let through
+  static constexpr size_t RATE_SLOT_COUNT = 256;
+  // how much of a suppressed message its summary repeats
+  static constexpr size_t SAMPLE_LENGTH = 120;
+
+  static Logger &get();
+
+  Logger();
+  ~Logger();
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  bool isEnabled(LogSeverity severity) const {
+    return severity >= minSeverity.load(std::memory_order_relaxed);
+  }
+  void setMinSeverity(LogSeverity severity) { minSeverity = severity; }
+  uint32_t getRateLimit() const { return rateLimit; }
+  void setRateLimit(uint32_t messagesPerSecond) {
+    rateLimit = messagesPerSecond;
+  }
+  uint64_t getDroppedCount() const { return droppedCount; }
+
+  // Copies the message, truncated to MAX_MESSAGE_LENGTH. An ID of 0 means
+  // the text identifies the message.
+  void push(LogSeverity severity, uint32_t id, std::string_view text);
+  // Waits until everything pushed so far has been written; for shutdown and
+  // before writing to the standard streams directly, never on the render
+  // thread.
+  void flush();
+
+ private:
+  // Ring slots, handed between producers and the flusher through their
+  // sequence number: equal to the position when free, one past it when
+  // written.
+  struct Entry {
+    std::atomic<size_t> sequence{0};
+    LogSeverity severity = LogSeverity::Info;
+    uint32_t id = 0;
+    uint32_t length = 0;
+    char text[MAX_MESSAGE_LENGTH];
+  };
+
+  // Per-ID message counts of the current window, in an open-addressed table
+  // shared by the producers. Updates race benignly, so the limit is
+  // approximate.
+  struct RateSlot {
+    std::atomic<uint32_t> id{0};
+    std::atomic<uint64_t> window{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> suppressedCount{0};
+  };
+
+  // The last message written with a rate slot's ID, repeated by its
+  // summaries. Kept per slot so the flusher never allocates.
+  struct Sample {
+    uint32_t id = 0;
+    LogSeverity severity = LogSeverity::Info;
+    uint32_t length = 0;
+    char text[SAMPLE_LENGTH];
+  };
+
+  static uint64_t currentWindow();
+  bool admit(uint32_t id);
+  // index of the rate slot tracking the ID, or RATE_SLOT_COUNT when none is
+  size_t findRateSlot(uint32_t id) const;
+
+  // flusher thread only
+  void flushLoop();
+  void drain();
+  void write(LogSeverity severity, uint32_t id, std::string_view text);
+  void reportSuppressed(bool windowsEnded);
+
+  std::array<Entry, CAPACITY> entries;
+  alignas(64) std::atomic<size_t> enqueuePosition{0};
+  alignas(64) size_t dequeuePosition = 0;
+  std::atomic<uint64_t> droppedCount{0};
+  std::atomic<LogSeverity> minSeverity{LogSeverity::Info};
+  std::atomic<uint32_t> rateLimit{DEFAULT_RATE_LIMIT};
+  std::array<RateSlot, RATE_SLOT_COUNT> rateSlots;
+
+  // flusher thread only, indexed like rateSlots
+  std::array<Sample, RATE_SLOT_COUNT> samples;
+  uint64_t reportedDroppedCount = 0;
+
+  std::mutex flushMutex;
+  std::condition_variable flushCondition;
+  std::condition_variable flushedCondition;
+  size_t flushedPosition = 0;
+  bool flushRequested = false;
+  bool stopping = false;
+  // started last, once everything it uses is initialized
+  std::thread thread;
+};
+
+// Formats one message into a fixed buffer, without allocating, and pushes it
+// when destroyed:
+//   LogMessage{LogSeverity::Info} << "Present mode: " << name;
+// Nothing is formatted when the severity is filtered out.
+class LogMessage {
+ public:
+  explicit LogMessage(LogSeverity severity, uint32_t id = 0);
+  ~LogMessage();
+
+  LogMessage(const LogMessage &) = delete;
+  LogMessage &operator=(const LogMessage &) = delete;
+
+  LogMessage &operator<<(std::string_view text);
+  LogMessage &operator<<(const char *text) {
+    return *this << std::string_view{text};
+  }
+  LogMessage &operator<<(const std::string &text) {
+    return *this << std::string_view{text};
+  }
+  LogMessage &operator<<(char c) { return *this << std::string_view{&c, 1}; }
+  LogMessage &operator<<(double value);
+  LogMessage &operator<<(float value) {
+    return *this << static_cast<double>(value);
+  }
+  template <typename T,
+            typename = std::enable_if_t<std::is_integral_v<T> &&
+                                        !std::is_same_v<T, bool>>>
+  LogMessage &operator<<(T value) {
+    if (!enabled) {
+      return *this;
+    }
+    char digits[24];
+    auto result = std::to_chars(std::begin(digits), std::end(digits), value);
+    return *this << std::string_view{
+               digits, static_cast<size_t>(result.ptr - digits)};
+  }
+
+ private:
+  LogSeverity severity;
+  uint32_t id;
+  bool enabled;
+  size_t length = 0;
+  std::array<char, Logger::MAX_MESSAGE_LENGTH> buffer;
+};
+
+}  // namespace lve
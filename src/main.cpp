@@ -1,7 +1,7 @@
 #include <cstdlib>
-#include <iostream>
 
 #include "app.h"
+#include "logger.h"
 
 int main() {
   lve::App app;
@@ -9,7 +9,7 @@ int main() {
   try {
     app.run();
   } catch (const std::exception& e) {
-    std::cerr << e.what() << std::endl;
+    lve::LogMessage{lve::LogSeverity::Error} << e.what();
     return EXIT_FAILURE;
   }
 
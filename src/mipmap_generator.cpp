@@ -0,0 +1,445 @@
+#include "mipmap_generator.h"
+
+// std lib headers
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace lve {
+
+struct DownsamplePushConstants {
+  int32_t srcWidth;
+  int32_t srcHeight;
+  int32_t dstWidth;
+  int32_t dstHeight;
+};
+
+static void transitionLevels(VkCommandBuffer commandBuffer,
+                             VkImage image,
+                             uint32_t baseLevel,
+                             uint32_t levelCount,
+                             VkImageLayout oldLayout,
+                             VkImageLayout newLayout,
+                             VkPipelineStageFlags srcStage,
+                             VkAccessFlags srcAccess,
+                             VkPipelineStageFlags dstStage,
+                             VkAccessFlags dstAccess) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {
+      VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1};
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       srcStage,
+                       dstStage,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+}
+
+MipmapGenerator::MipmapGenerator(Device &device, SamplerCache &samplerCache)
+    : device{device} {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = 0.0f;
+  sampler = samplerCache.getSampler(samplerInfo);
+
+  createDescriptorSetLayout();
+  createPipelineLayout();
+  createDescriptorPool();
+}
+
+MipmapGenerator::~MipmapGenerator() {
+  pipeline = nullptr;
+  vkDestroyPipelineLayout(device.device(), pipelineLayout, device.allocator());
+  vkDestroyDescriptorPool(device.device(), descriptorPool, device.allocator());
+  vkDestroyDescriptorSetLayout(
+      device.device(), descriptorSetLayout, device.allocator());
+}
+
+uint32_t MipmapGenerator::getMipLevelCount(VkExtent2D extent) {
+  uint32_t levels = 1;
+  for (uint32_t size = std::max(extent.width, extent.height); size > 1;
+       size /= 2) {
+    levels++;
+  }
+  return levels;
+}
+
+VkImageUsageFlags MipmapGenerator::getRequiredUsage(VkFormat format) {
+  VkImageUsageFlags usage =
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (supportsBlit(format)) {
+    return usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
+  if (supportsCompute(format)) {
+    return usage | VK_IMAGE_USAGE_STORAGE_BIT;
+  }
+  throw std::runtime_error(
+      "failed to find a mipmap generation path for the texture format!");
+}
+
+void MipmapGenerator::generate(VkImage image,
+                               VkFormat format,
+                               VkExtent2D extent,
+                               uint32_t mipLevels) {
+  bool blit = supportsBlit(format);
+  if (!blit && !supportsCompute(format)) {
+    throw std::runtime_error(
+        "failed to find a mipmap generation path for the texture format!");
+  }
+  if (mipLevels > MAX_LEVELS) {
+    throw std::runtime_error("too many mip levels to generate!");
+  }
+
+  VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+  std::vector<VkImageView> levelViews;
+  if (blit) {
+    recordBlits(commandBuffer, image, extent, mipLevels);
+  } else {
+    recordComputeDownsample(
+        commandBuffer, image, format, extent, mipLevels, levelViews);
+  }
+  device.endSingleTimeCommands(commandBuffer);
+
+  for (auto levelView : levelViews) {
+    vkDestroyImageView(device.device(), levelView, device.allocator());
+  }
+  vkResetDescriptorPool(device.device(), descriptorPool, 0);
+}
+
+bool MipmapGenerator::supportsBlit(VkFormat format) {
+  return device.isFormatSupported(
+      format,
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
+
+bool MipmapGenerator::supportsCompute(VkFormat format) {
+  return device.supportsStorageImageWriteWithoutFormat() &&
+         device.isFormatSupported(format,
+                                  VK_IMAGE_TILING_OPTIMAL,
+                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                      VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+}
+
+void MipmapGenerator::createDescriptorSetLayout() {
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(device.device(),
+                                  &layoutInfo,
+                                  device.allocator(),
+                                  &descriptorSetLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create mipmap descriptor set layout!");
+  }
+}
+
+void MipmapGenerator::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(DownsamplePushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device.device(),
+                             &pipelineLayoutInfo,
+                             device.allocator(),
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create mipmap pipeline layout!");
+  }
+}
+
+void MipmapGenerator::createDescriptorPool() {
+  // one set per generated level, reset after every generate()
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = MAX_LEVELS;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = MAX_LEVELS;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = MAX_LEVELS;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  if (vkCreateDescriptorPool(
+          device.device(), &poolInfo, device.allocator(), &descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create mipmap descriptor pool!");
+  }
+}
+
+void MipmapGenerator::recordBlits(VkCommandBuffer commandBuffer,
+                                  VkImage image,
+                                  VkExtent2D extent,
+                                  uint32_t mipLevels) {
+  if (mipLevels > 1) {
+    transitionLevels(commandBuffer,
+                     image,
+                     1,
+                     mipLevels - 1,
+                     VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                     0,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_ACCESS_TRANSFER_WRITE_BIT);
+  }
+
+  int32_t width = static_cast<int32_t>(extent.width);
+  int32_t height = static_cast<int32_t>(extent.height);
+  for (uint32_t level = 1; level < mipLevels; level++) {
+    transitionLevels(commandBuffer,
+                     image,
+                     level - 1,
+                     1,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_ACCESS_TRANSFER_READ_BIT);
+
+    int32_t nextWidth = std::max(width / 2, 1);
+    int32_t nextHeight = std::max(height / 2, 1);
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+    blit.srcOffsets[1] = {width, height, 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+    blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+    vkCmdBlitImage(commandBuffer,
+                   image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1,
+                   &blit,
+                   VK_FILTER_LINEAR);
+
+    // the source level is final once the blit has read it
+    transitionLevels(commandBuffer,
+                     image,
+                     level - 1,
+                     1,
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_ACCESS_TRANSFER_READ_BIT,
+                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                     VK_ACCESS_SHADER_READ_BIT);
+
+    width = nextWidth;
+    height = nextHeight;
+  }
+
+  transitionLevels(commandBuffer,
+                   image,
+                   mipLevels - 1,
+                   1,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                   VK_ACCESS_TRANSFER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                   VK_ACCESS_SHADER_READ_BIT);
+}
+
+std::unique_ptr<Pipeline> MipmapGenerator::buildPipeline() const {
+  return std::make_unique<Pipeline>(
+      device, DOWNSAMPLE_SHADER_PATH, pipelineLayout);
+}
+
+void MipmapGenerator::replacePipeline(std::unique_ptr<Pipeline> replacement) {
+  pipeline = std::move(replacement);
+}
+
+void MipmapGenerator::recordComputeDownsample(
+    VkCommandBuffer commandBuffer,
+    VkImage image,
+    VkFormat format,
+    VkExtent2D extent,
+    uint32_t mipLevels,
+    std::vector<VkImageView> &levelViews) {
+  if (pipeline == nullptr) {
+    pipeline = buildPipeline();
+  }
+
+  // every level stays in GENERAL while it is written and then read
+  transitionLevels(commandBuffer,
+                   image,
+                   0,
+                   1,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_IMAGE_LAYOUT_GENERAL,
+                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                   VK_ACCESS_TRANSFER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_SHADER_READ_BIT);
+  if (mipLevels > 1) {
+    transitionLevels(commandBuffer,
+                     image,
+                     1,
+                     mipLevels - 1,
+                     VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_GENERAL,
+                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                     0,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                     VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  for (uint32_t level = 0; level < mipLevels; level++) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+
+    VkImageView levelView;
+    if (vkCreateImageView(device.device(),
+                          &viewInfo,
+                          device.allocator(),
+                          &levelView) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create mip level view!");
+    }
+    levelViews.push_back(levelView);
+  }
+
+  pipeline->bind(commandBuffer);
+
+  VkExtent2D srcExtent = extent;
+  for (uint32_t level = 1; level < mipLevels; level++) {
+    VkExtent2D dstExtent{std::max(srcExtent.width / 2, 1u),
+                         std::max(srcExtent.height / 2, 1u)};
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+
+    VkDescriptorSet descriptorSet;
+    if (vkAllocateDescriptorSets(
+            device.device(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate mipmap descriptor set!");
+    }
+
+    VkDescriptorImageInfo srcInfo{};
+    srcInfo.sampler = sampler;
+    srcInfo.imageView = levelViews[level - 1];
+    srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorImageInfo dstInfo{};
+    dstInfo.imageView = levelViews[level];
+    dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = descriptorSet;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &srcInfo;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = descriptorSet;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].pImageInfo = &dstInfo;
+    vkUpdateDescriptorSets(device.device(),
+                           static_cast<uint32_t>(writes.size()),
+                           writes.data(),
+                           0,
+                           nullptr);
+
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout,
+                            0,
+                            1,
+                            &descriptorSet,
+                            0,
+                            nullptr);
+
+    DownsamplePushConstants push{};
+    push.srcWidth = static_cast<int32_t>(srcExtent.width);
+    push.srcHeight = static_cast<int32_t>(srcExtent.height);
+    push.dstWidth = static_cast<int32_t>(dstExtent.width);
+    push.dstHeight = static_cast<int32_t>(dstExtent.height);
+    vkCmdPushConstants(commandBuffer,
+                       pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(DownsamplePushConstants),
+                       &push);
+    vkCmdDispatch(commandBuffer,
+                  (dstExtent.width + 7) / 8,
+                  (dstExtent.height + 7) / 8,
+                  1);
+
+    // the next level reads this one
+    transitionLevels(commandBuffer,
+                     image,
+                     level,
+                     1,
+                     VK_IMAGE_LAYOUT_GENERAL,
+                     VK_IMAGE_LAYOUT_GENERAL,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                     VK_ACCESS_SHADER_WRITE_BIT,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                     VK_ACCESS_SHADER_READ_BIT);
+
+    srcExtent = dstExtent;
+  }
+
+  transitionLevels(commandBuffer,
+                   image,
+                   0,
+                   mipLevels,
+                   VK_IMAGE_LAYOUT_GENERAL,
+                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_SHADER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                   VK_ACCESS_SHADER_READ_BIT);
+}
+
+}  // namespace lve
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "device.h"
+#include "pipeline.h"
+#include "sampler_cache.h"
+
+// std lib headers
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Fills a texture's mip chain on the GPU from its level 0.
+//
+// Formats that support linear-filtered blits are downsampled level by level
+// with vkCmdBlitImage. Formats that do not, such as many float formats, fall
+// back to a 2x2 box filter in a compute shader that writes each level as a
+// storage image.
+class MipmapGenerator {
+ public:
+  static constexpr uint32_t MAX_LEVELS = 16;
+  static constexpr const char *DOWNSAMPLE_SHADER_PATH =
+      "src/shaders/mip_downsample.comp.spv";
+
+  MipmapGenerator(Device &device, SamplerCache &samplerCache);
+  ~MipmapGenerator();
+
+  MipmapGenerator(const MipmapGenerator &) = delete;
+  MipmapGenerator &operator=(const MipmapGenerator &) = delete;
+
+  static uint32_t getMipLevelCount(VkExtent2D extent);
+  // What the image has to be created with for generate() to handle its
+  // format; throws when neither path supports the format.
+  VkImageUsageFlags getRequiredUsage(VkFormat format);
+
+  // Expects level 0 in TRANSFER_DST_OPTIMAL, e.g. after copyBufferToImage, and
+  // leaves every level in SHADER_READ_ONLY_OPTIMAL. Waits for the GPU like
+  // the other single-time helpers.
+  void generate(VkImage image,
+                VkFormat format,
+                VkExtent2D extent,
+                uint32_t mipLevels);
+
+  // false until the compute path was first taken
+  bool hasPipeline() const { return pipeline != nullptr; }
+  // Builds a compute downsample pipeline from the current shader; may run on
+  // any thread.
+  std::unique_ptr<Pipeline> buildPipeline() const;
+  // Swaps in a pipeline from buildPipeline(), retiring the replaced one
+  // through the deletion queue.
+  void replacePipeline(std::unique_ptr<Pipeline> replacement);
+
+ private:
+  bool supportsBlit(VkFormat format);
+  bool supportsCompute(VkFormat format);
+
+  void createDescriptorSetLayout();
+  void createPipelineLayout();
+  void createDescriptorPool();
+
+  void recordBlits(VkCommandBuffer commandBuffer,
+                   VkImage image,
+                   VkExtent2D extent,
+                   uint32_t mipLevels);
+  // the level views have to outlive the command buffer
+  void recordComputeDownsample(VkCommandBuffer commandBuffer,
+                               VkImage image,
+                               VkFormat format,
+                               VkExtent2D extent,
+                               uint32_t mipLevels,
+                               std::vector<VkImageView> &levelViews);
+
+  Device &device;
+  VkSampler sampler;
+  VkDescriptorSetLayout descriptorSetLayout;
+  VkDescriptorPool descriptorPool;
+  VkPipelineLayout pipelineLayout;
+  // created on first use, devices without formatless storage writes never
+  // take the compute path
+  std::unique_ptr<Pipeline> pipeline;
+};
+
+}  // namespace lve
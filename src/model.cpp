@@ -1,6 +1,7 @@
 #include "model.h"
 
-#include <cstring>
+#include <algorithm>
+#include <cmath>
 
 namespace lve {
 
@@ -10,13 +11,64 @@ Model::Model(Device& device, const std::vector<Vertex>& vertices)
 }
 
 Model::~Model() {
-  vkDestroyBuffer(device.device(), vertexBuffer, nullptr);
-  vkFreeMemory(device.device(), vertexBufferMemory, nullptr);
+  device.getDeletionQueue().push(
+      [device = device.device(),
+       allocator = device.allocator(),
+       buffer = vertexBuffer,
+       memory = vertexBufferMemory] {
+        vkDestroyBuffer(device, buffer, allocator);
+        vkFreeMemory(device, memory, allocator);
+      });
+}
+
+void Model::packVertices(const std::vector<Vertex>& vertices,
+                         PositionVertex* positions,
+                         AttributeVertex* attributes) {
+  glm::vec2 minPosition{0.0f, 0.0f};
+  glm::vec2 maxPosition{0.0f, 0.0f};
+  if (!vertices.empty()) {
+    minPosition = maxPosition = vertices[0].position;
+  }
+  for (const auto& vertex : vertices) {
+    minPosition = glm::min(minPosition, vertex.position);
+    maxPosition = glm::max(maxPosition, vertex.position);
+  }
+
+  // map the bounds onto the [-1, 1] SNORM range, a degenerate axis keeps a
+  // unit scale so it still round trips exactly
+  positionOffset = (minPosition + maxPosition) * 0.5f;
+  positionScale = (maxPosition - minPosition) * 0.5f;
+  for (int i = 0; i < 2; i++) {
+    if (positionScale[i] <= 0.0f) {
+      positionScale[i] = 1.0f;
+    }
+  }
+
+  auto toSnorm16 = [](float value) {
+    return static_cast<int16_t>(
+        std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+  };
+  auto toUnorm8 = [](float value) {
+    return static_cast<uint8_t>(
+        std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+  };
+
+  for (size_t i = 0; i < vertices.size(); i++) {
+    glm::vec2 normalized =
+        (vertices[i].position - positionOffset) / positionScale;
+    positions[i].position = {toSnorm16(normalized.x), toSnorm16(normalized.y)};
+    attributes[i].color = {toUnorm8(vertices[i].color.x),
+                           toUnorm8(vertices[i].color.y),
+                           toUnorm8(vertices[i].color.z),
+                           255};
+  }
 }
 
 void Model::createVertexBuffers(const std::vector<Vertex>& vertices) {
   vertexCount = static_cast<uint32_t>(vertices.size());
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
+  attributeOffset = sizeof(PositionVertex) * vertexCount;
+  VkDeviceSize bufferSize =
+      attributeOffset + sizeof(AttributeVertex) * vertexCount;
   device.createBuffer(bufferSize,
                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
@@ -25,11 +77,20 @@ void Model::createVertexBuffers(const std::vector<Vertex>& vertices) {
                       vertexBufferMemory);
   void* data;
   vkMapMemory(device.device(), vertexBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
+  auto bytes = static_cast<char*>(data);
+  packVertices(vertices,
+               reinterpret_cast<PositionVertex*>(bytes),
+               reinterpret_cast<AttributeVertex*>(bytes + attributeOffset));
   vkUnmapMemory(device.device(), vertexBufferMemory);
 }
 
 void Model::bind(VkCommandBuffer commandBuffer) {
+  VkBuffer buffers[] = {vertexBuffer, vertexBuffer};
+  VkDeviceSize offsets[] = {0, attributeOffset};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+}
+
+void Model::bindPositions(VkCommandBuffer commandBuffer) {
   VkBuffer buffers[] = {vertexBuffer};
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
@@ -39,28 +100,4 @@ void Model::draw(VkCommandBuffer commandBuffer) {
   vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
 }
 
-std::vector<VkVertexInputBindingDescription>
-Model::Vertex::getBindingDescriptions() {
-  std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-  bindingDescriptions[0].binding = 0;
-  bindingDescriptions[0].stride = sizeof(Vertex);
-  bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-  return bindingDescriptions;
-}
-
-std::vector<VkVertexInputAttributeDescription>
-Model::Vertex::getAttributeDescriptions() {
-  std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
-  attributeDescriptions[0].binding = 0;
-  attributeDescriptions[0].location = 0;
-  attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-  attributeDescriptions[0].offset = 0;
-  attributeDescriptions[1].binding = 0;
-  attributeDescriptions[1].location = 1;
-  attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-  return attributeDescriptions;
-}
-
 }  // namespace lve
@@ -5,21 +5,45 @@
 #include <glm/glm.hpp>
 
 #include "device.h"
+#include "vertex_layout.h"
+
+// std lib headers
+#include <cstdint>
+#include <vector>
 
 namespace lve {
 
 class Model {
  public:
+  // Full precision vertex used to author meshes on the CPU.
   struct Vertex {
     glm::vec2 position;
     glm::vec3 color;
+  };
+
+  // Compact vertex data actually stored in the vertex buffer, split in two
+  // streams so depth-only passes can fetch positions alone. Positions are
+  // quantized to 16-bit SNORM relative to the mesh bounds (dequantized in the
+  // vertex shader with getPositionScale/getPositionOffset) and colors are
+  // packed to RGBA8 UNORM. 8 bytes per vertex instead of 20.
+  struct PositionVertex {
+    Snorm16x2 position;
+  };
 
-    static std::vector<VkVertexInputBindingDescription>
-    getBindingDescriptions();
-    static std::vector<VkVertexInputAttributeDescription>
-    getAttributeDescriptions();
+  struct AttributeVertex {
+    Unorm8x4 color;
   };
 
+  using PositionStream =
+      VertexStream<PositionVertex,
+                   LVE_VERTEX_ATTRIBUTE(PositionVertex, position)>;
+  using AttributeStream =
+      VertexStream<AttributeVertex,
+                   LVE_VERTEX_ATTRIBUTE(AttributeVertex, color)>;
+
+  using Layout = VertexLayout<PositionStream, AttributeStream>;
+  using PositionOnlyLayout = VertexLayout<PositionStream>;
+
   Model(Device& device, const std::vector<Vertex>& vertices);
   ~Model();
 
@@ -27,15 +51,26 @@ class Model {
   Model& operator=(const Model&) = delete;
 
   void bind(VkCommandBuffer commandBuffer);
+  void bindPositions(VkCommandBuffer commandBuffer);
   void draw(VkCommandBuffer commandBuffer);
 
+  glm::vec2 getPositionScale() const { return positionScale; }
+  glm::vec2 getPositionOffset() const { return positionOffset; }
+
  private:
   void createVertexBuffers(const std::vector<Vertex>& vertices);
+  void packVertices(const std::vector<Vertex>& vertices,
+                    PositionVertex* positions,
+                    AttributeVertex* attributes);
 
   Device& device;
+  // both streams live in one buffer, attributes start at attributeOffset
   VkBuffer vertexBuffer;
   VkDeviceMemory vertexBufferMemory;
+  VkDeviceSize attributeOffset;
   uint32_t vertexCount;
+  glm::vec2 positionScale{1.0f, 1.0f};
+  glm::vec2 positionOffset{0.0f, 0.0f};
 };
 
 }  // namespace lve
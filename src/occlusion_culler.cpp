@@ -0,0 +1,507 @@
+#include "occlusion_culler.h"
+
+// std headers
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace lve {
+
+struct PyramidPushConstants {
+  int32_t srcWidth;
+  int32_t srcHeight;
+  int32_t dstWidth;
+  int32_t dstHeight;
+};
+
+OcclusionCuller::OcclusionCuller(Device &device,
+                                 SamplerCache &samplerCache,
+                                 VkExtent2D depthExtent)
+    : device{device}, depthExtent{depthExtent} {
+  computeLevels();
+  createSampler(samplerCache);
+  createDescriptorSetLayout();
+  createPipelineLayout();
+  pipeline = buildPipeline();
+  createFrameResources();
+  createDescriptorSets();
+}
+
+OcclusionCuller::~OcclusionCuller() {
+  destroyLevelViews();
+  pipeline = nullptr;
+
+  std::vector<VkBuffer> readbackBuffers;
+  std::vector<VkDeviceMemory> readbackMemories;
+  for (auto &frame : frames) {
+    readbackBuffers.push_back(frame.readbackBuffer);
+    readbackMemories.push_back(frame.readbackMemory);
+  }
+  device.getDeletionQueue().push(
+      [device = device.device(),
+       allocator = device.allocator(),
+       readbackBuffers,
+       readbackMemories,
+       pipelineLayout = pipelineLayout,
+       descriptorPool = descriptorPool,
+       descriptorSetLayout = descriptorSetLayout] {
+        for (size_t i = 0; i < readbackBuffers.size(); i++) {
+          vkUnmapMemory(device, readbackMemories[i]);
+          vkDestroyBuffer(device, readbackBuffers[i], allocator);
+          vkFreeMemory(device, readbackMemories[i], allocator);
+        }
+        vkDestroyPipelineLayout(device, pipelineLayout, allocator);
+        vkDestroyDescriptorPool(device, descriptorPool, allocator);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, allocator);
+      });
+}
+
+void OcclusionCuller::computeLevels() {
+  // level 0 is half the depth resolution, every texel holds the farthest
+  // depth of the 2x2 texels below it
+  VkExtent2D extent = depthExtent;
+  do {
+    extent.width = std::max(1u, (extent.width + 1) / 2);
+    extent.height = std::max(1u, (extent.height + 1) / 2);
+    levelExtents.push_back(extent);
+  } while (extent.width > 1 || extent.height > 1);
+
+  // only the coarse levels are copied back, they are all the CPU test needs
+  readbackBaseLevel = 0;
+  while (std::max(levelExtents[readbackBaseLevel].width,
+                  levelExtents[readbackBaseLevel].height) > READBACK_MAX_SIZE) {
+    readbackBaseLevel++;
+  }
+
+  readbackOffsets.assign(levelExtents.size(), 0);
+  readbackSize = 0;
+  for (size_t level = readbackBaseLevel; level < levelExtents.size();
+       level++) {
+    readbackOffsets[level] = readbackSize;
+    readbackSize += sizeof(float) * levelExtents[level].width *
+                    levelExtents[level].height;
+  }
+}
+
+void OcclusionCuller::createSampler(SamplerCache &samplerCache) {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = 0.0f;
+  sampler = samplerCache.getSampler(samplerInfo);
+}
+
+void OcclusionCuller::createDescriptorSetLayout() {
+  std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(device.device(),
+                                  &layoutInfo,
+                                  device.allocator(),
+                                  &descriptorSetLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z descriptor set layout!");
+  }
+}
+
+void OcclusionCuller::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(PyramidPushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device.device(),
+                             &pipelineLayoutInfo,
+                             device.allocator(),
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z pipeline layout!");
+  }
+}
+
+std::unique_ptr<Pipeline> OcclusionCuller::buildPipeline() const {
+  return std::make_unique<Pipeline>(
+      device, DOWNSAMPLE_SHADER_PATH, pipelineLayout);
+}
+
+void OcclusionCuller::replacePipeline(std::unique_ptr<Pipeline> replacement) {
+  pipeline = std::move(replacement);
+}
+
+void OcclusionCuller::createFrameResources() {
+  for (auto &frame : frames) {
+    device.createBuffer(readbackSize,
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        frame.readbackBuffer,
+                        frame.readbackMemory);
+    void *data;
+    vkMapMemory(
+        device.device(), frame.readbackMemory, 0, readbackSize, 0, &data);
+    frame.readbackData = static_cast<const float *>(data);
+  }
+}
+
+void OcclusionCuller::createDescriptorSets() {
+  uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+  uint32_t setCount = levelCount * SwapChain::MAX_FRAMES_IN_FLIGHT;
+
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = setCount;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = setCount;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = setCount;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  if (vkCreateDescriptorPool(
+          device.device(), &poolInfo, device.allocator(), &descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create hi-z descriptor pool!");
+  }
+
+  std::vector<VkDescriptorSetLayout> layouts(levelCount, descriptorSetLayout);
+  for (auto &frame : frames) {
+    frame.descriptorSets.resize(levelCount);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = levelCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(
+            device.device(), &allocInfo, frame.descriptorSets.data()) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate hi-z descriptor sets!");
+    }
+  }
+}
+
+VkImageCreateInfo OcclusionCuller::getPyramidImageInfo() const {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = levelExtents[0].width;
+  imageInfo.extent.height = levelExtents[0].height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = static_cast<uint32_t>(levelExtents.size());
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.flags = 0;
+  return imageInfo;
+}
+
+void OcclusionCuller::setPyramid(VkImage pyramid) {
+  destroyLevelViews();
+  for (auto &frame : frames) {
+    frame.depthImageView = VK_NULL_HANDLE;
+  }
+  if (pyramid == VK_NULL_HANDLE) {
+    return;
+  }
+  this->pyramid = pyramid;
+
+  uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+  levelViews.resize(levelCount);
+  for (uint32_t level = 0; level < levelCount; level++) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = pyramid;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = level;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device.device(),
+                          &viewInfo,
+                          device.allocator(),
+                          &levelViews[level]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create hi-z image view!");
+    }
+  }
+
+  // level 0 reads whichever depth image the frame rendered to and is
+  // written at record time
+  for (auto &frame : frames) {
+    for (uint32_t level = 1; level < levelCount; level++) {
+      writeDescriptorSet(frame.descriptorSets[level],
+                         levelViews[level - 1],
+                         VK_IMAGE_LAYOUT_GENERAL,
+                         levelViews[level]);
+    }
+  }
+}
+
+void OcclusionCuller::destroyLevelViews() {
+  device.getDeletionQueue().push(
+      [device = device.device(),
+       allocator = device.allocator(),
+       levelViews = levelViews] {
+        for (auto levelView : levelViews) {
+          vkDestroyImageView(device, levelView, allocator);
+        }
+      });
+  levelViews.clear();
+  pyramid = VK_NULL_HANDLE;
+}
+
+void OcclusionCuller::writeDescriptorSet(VkDescriptorSet descriptorSet,
+                                         VkImageView srcView,
+                                         VkImageLayout srcLayout,
+                                         VkImageView dstView) {
+  VkDescriptorImageInfo srcInfo{};
+  srcInfo.sampler = sampler;
+  srcInfo.imageView = srcView;
+  srcInfo.imageLayout = srcLayout;
+
+  VkDescriptorImageInfo dstInfo{};
+  dstInfo.imageView = dstView;
+  dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  std::array<VkWriteDescriptorSet, 2> writes{};
+  writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[0].dstSet = descriptorSet;
+  writes[0].dstBinding = 0;
+  writes[0].descriptorCount = 1;
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[0].pImageInfo = &srcInfo;
+  writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[1].dstSet = descriptorSet;
+  writes[1].dstBinding = 1;
+  writes[1].descriptorCount = 1;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  writes[1].pImageInfo = &dstInfo;
+
+  vkUpdateDescriptorSets(device.device(),
+                         static_cast<uint32_t>(writes.size()),
+                         writes.data(),
+                         0,
+                         nullptr);
+}
+
+void OcclusionCuller::beginFrame(int frameIndex) {
+  const auto &frame = frames[frameIndex];
+  testFrame = frame.readbackValid ? &frame : nullptr;
+  tested = 0;
+  culled = 0;
+}
+
+void OcclusionCuller::invalidate() {
+  for (auto &frame : frames) {
+    frame.readbackValid = false;
+  }
+  testFrame = nullptr;
+  std::fill(occludedStreaks.begin(), occludedStreaks.end(), 0);
+}
+
+bool OcclusionCuller::isVisible(uint32_t objectId,
+                                const OcclusionBounds &bounds) {
+  if (objectId >= occludedStreaks.size()) {
+    occludedStreaks.resize(objectId + 1, 0);
+  }
+  tested++;
+
+  bool occluded = false;
+  if (testFrame != nullptr) {
+    glm::vec2 extent{static_cast<float>(depthExtent.width),
+                     static_cast<float>(depthExtent.height)};
+    glm::vec2 pixelMin = glm::clamp(
+        (bounds.min * 0.5f + glm::vec2{0.5f, 0.5f}) * extent,
+        glm::vec2{0.0f, 0.0f},
+        extent);
+    glm::vec2 pixelMax = glm::clamp(
+        (bounds.max * 0.5f + glm::vec2{0.5f, 0.5f}) * extent,
+        glm::vec2{0.0f, 0.0f},
+        extent);
+
+    // off-screen objects are left to frustum culling
+    if (pixelMax.x > pixelMin.x && pixelMax.y > pixelMin.y) {
+      occluded = bounds.nearestDepth > maxDepth(pixelMin, pixelMax);
+    }
+  }
+
+  uint8_t &streak = occludedStreaks[objectId];
+  if (!occluded) {
+    streak = 0;
+    return true;
+  }
+  streak = std::min<uint8_t>(streak + 1, OCCLUSION_CONFIRM_FRAMES);
+  if (streak < OCCLUSION_CONFIRM_FRAMES) {
+    return true;
+  }
+  culled++;
+  return false;
+}
+
+float OcclusionCuller::maxDepth(glm::vec2 pixelMin, glm::vec2 pixelMax) const {
+  // walk down to the first level where the rectangle covers at most 4x4
+  // texels; level L texels span 2^(L+1) depth pixels
+  uint32_t lastLevel = static_cast<uint32_t>(levelExtents.size()) - 1;
+  for (uint32_t level = readbackBaseLevel;; level++) {
+    float texelSize = static_cast<float>(2u << level);
+    const VkExtent2D &extent = levelExtents[level];
+    int32_t x0 = static_cast<int32_t>(std::floor(pixelMin.x / texelSize));
+    int32_t y0 = static_cast<int32_t>(std::floor(pixelMin.y / texelSize));
+    int32_t x1 = static_cast<int32_t>(std::ceil(pixelMax.x / texelSize)) - 1;
+    int32_t y1 = static_cast<int32_t>(std::ceil(pixelMax.y / texelSize)) - 1;
+    x1 = std::min(x1, static_cast<int32_t>(extent.width) - 1);
+    y1 = std::min(y1, static_cast<int32_t>(extent.height) - 1);
+
+    if ((x1 - x0 + 1) * (y1 - y0 + 1) > 16 && level < lastLevel) {
+      continue;
+    }
+
+    const float *texels = testFrame->readbackData +
+                          readbackOffsets[level] / sizeof(float);
+    float farthest = 0.0f;
+    for (int32_t y = y0; y <= y1; y++) {
+      for (int32_t x = x0; x <= x1; x++) {
+        farthest = std::max(farthest, texels[y * extent.width + x]);
+      }
+    }
+    return farthest;
+  }
+}
+
+void OcclusionCuller::recordPyramidBuild(VkCommandBuffer commandBuffer,
+                                         int frameIndex,
+                                         VkImageView depthImageView) {
+  auto &frame = frames[frameIndex];
+  uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+
+  if (frame.depthImageView != depthImageView) {
+    writeDescriptorSet(frame.descriptorSets[0],
+                       depthImageView,
+                       VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                       levelViews[0]);
+    frame.depthImageView = depthImageView;
+  }
+
+  pipeline->bind(commandBuffer);
+
+  VkExtent2D srcExtent = depthExtent;
+  for (uint32_t level = 0; level < levelCount; level++) {
+    if (level > 0) {
+      VkImageMemoryBarrier levelBarrier{};
+      levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+      levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+      levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      levelBarrier.image = pyramid;
+      levelBarrier.subresourceRange = {
+          VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1, 0, 1};
+
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           0,
+                           0,
+                           nullptr,
+                           0,
+                           nullptr,
+                           1,
+                           &levelBarrier);
+    }
+
+    const VkExtent2D &dstExtent = levelExtents[level];
+    PyramidPushConstants push{};
+    push.srcWidth = static_cast<int32_t>(srcExtent.width);
+    push.srcHeight = static_cast<int32_t>(srcExtent.height);
+    push.dstWidth = static_cast<int32_t>(dstExtent.width);
+    push.dstHeight = static_cast<int32_t>(dstExtent.height);
+
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout,
+                            0,
+                            1,
+                            &frame.descriptorSets[level],
+                            0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer,
+                       pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(PyramidPushConstants),
+                       &push);
+    vkCmdDispatch(commandBuffer,
+                  (dstExtent.width + 7) / 8,
+                  (dstExtent.height + 7) / 8,
+                  1);
+
+    srcExtent = dstExtent;
+  }
+}
+
+void OcclusionCuller::recordReadback(VkCommandBuffer commandBuffer,
+                                     int frameIndex,
+                                     std::pmr::memory_resource *scratch) {
+  auto &frame = frames[frameIndex];
+  uint32_t levelCount = static_cast<uint32_t>(levelExtents.size());
+
+  // only the coarse levels are needed by the CPU test
+  std::pmr::vector<VkBufferImageCopy> regions{scratch};
+  regions.reserve(levelCount - readbackBaseLevel);
+  for (uint32_t level = readbackBaseLevel; level < levelCount; level++) {
+    VkBufferImageCopy region{};
+    region.bufferOffset = readbackOffsets[level];
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {levelExtents[level].width,
+                          levelExtents[level].height,
+                          1};
+    regions.push_back(region);
+  }
+
+  vkCmdCopyImageToBuffer(commandBuffer,
+                         pyramid,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         frame.readbackBuffer,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+
+  frame.readbackValid = true;
+}
+
+}  // namespace lve
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "device.h"
+#include "pipeline.h"
+#include "sampler_cache.h"
+#include "swapchain.h"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std lib headers
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace lve {
+
+// Conservative screen-space bounds of an object: NDC rectangle plus the
+// depth of its nearest point.
+struct OcclusionBounds {
+  glm::vec2 min;
+  glm::vec2 max;
+  float nearestDepth;
+};
+
+// Hierarchical-Z occlusion culling. Every frame a compute pass reduces the
+// depth buffer into a max-depth mip pyramid and a transfer pass copies its
+// coarse levels to host memory; both run as render graph passes, which own
+// the pyramid image and the barriers around them. Objects are then tested on
+// the CPU against the pyramid of the last frame that used the same frame
+// slot, which is complete by the time the slot's fence has been waited on,
+// so the test never stalls the GPU.
+//
+// Because the pyramid lags by MAX_FRAMES_IN_FLIGHT frames, visibility uses a
+// two-step rule: an object is drawn as soon as one test passes, but is only
+// culled after it failed OCCLUSION_CONFIRM_FRAMES consecutive tests. This
+// keeps objects that were just disoccluded or are only briefly hidden from
+// popping.
+class OcclusionCuller {
+ public:
+  static constexpr uint32_t READBACK_MAX_SIZE = 64;
+  static constexpr uint8_t OCCLUSION_CONFIRM_FRAMES = 2;
+  static constexpr const char *DOWNSAMPLE_SHADER_PATH =
+      "src/shaders/hiz_downsample.comp.spv";
+
+  OcclusionCuller(Device &device,
+                  SamplerCache &samplerCache,
+                  VkExtent2D depthExtent);
+  ~OcclusionCuller();
+
+  OcclusionCuller(const OcclusionCuller &) = delete;
+  OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+  // Selects the pyramid tested by isVisible; call after the frame slot's fence
+  // has been waited on.
+  void beginFrame(int frameIndex);
+  bool isVisible(uint32_t objectId, const OcclusionBounds &bounds);
+
+  VkImageCreateInfo getPyramidImageInfo() const;
+  // Points the downsample passes at the pyramid allocated by the render graph,
+  // or detaches them with VK_NULL_HANDLE; the device must be idle.
+  void setPyramid(VkImage pyramid);
+  VkBuffer getReadbackBuffer(int frameIndex) const {
+    return frames[frameIndex].readbackBuffer;
+  }
+
+  // Expects the depth image in DEPTH_STENCIL_READ_ONLY_OPTIMAL and the
+  // pyramid in GENERAL.
+  void recordPyramidBuild(VkCommandBuffer commandBuffer,
+                          int frameIndex,
+                          VkImageView depthImageView);
+  // Expects the pyramid in TRANSFER_SRC_OPTIMAL; the copy is tested on the
+  // next use of this frame slot. The copy regions are allocated from scratch.
+  void recordReadback(
+      VkCommandBuffer commandBuffer,
+      int frameIndex,
+      std::pmr::memory_resource *scratch = std::pmr::get_default_resource());
+
+  // Forgets all pyramids, e.g. when culling was paused for a while.
+  void invalidate();
+
+  // Builds a downsample pipeline from the current shader; may run on any
+  // thread, e.g. as a job while frames keep using the current pipeline.
+  std::unique_ptr<Pipeline> buildPipeline() const;
+  // Swaps in a pipeline from buildPipeline(); the replaced one is retired
+  // through the deletion queue. Command buffers have to be recorded again.
+  void replacePipeline(std::unique_ptr<Pipeline> replacement);
+
+  uint32_t testedCount() const { return tested; }
+  uint32_t culledCount() const { return culled; }
+
+ private:
+  struct FrameResources {
+    std::vector<VkDescriptorSet> descriptorSets;
+    VkBuffer readbackBuffer;
+    VkDeviceMemory readbackMemory;
+    const float *readbackData;
+    bool readbackValid = false;
+    // what descriptorSets[0] reads; rewritten only when it changes, since
+    // updating the set invalidates command buffers recorded with it
+    VkImageView depthImageView = VK_NULL_HANDLE;
+  };
+
+  void computeLevels();
+  void createSampler(SamplerCache &samplerCache);
+  void createDescriptorSetLayout();
+  void createPipelineLayout();
+  void createFrameResources();
+  void createDescriptorSets();
+  void destroyLevelViews();
+  void writeDescriptorSet(VkDescriptorSet descriptorSet,
+                          VkImageView srcView,
+                          VkImageLayout srcLayout,
+                          VkImageView dstView);
+
+  // farthest depth over a pixel rectangle of the tested pyramid
+  float maxDepth(glm::vec2 pixelMin, glm::vec2 pixelMax) const;
+
+  Device &device;
+  VkExtent2D depthExtent;
+  std::vector<VkExtent2D> levelExtents;
+  uint32_t readbackBaseLevel = 0;
+  std::vector<VkDeviceSize> readbackOffsets;
+  VkDeviceSize readbackSize = 0;
+
+  // owned by the sampler cache
+  VkSampler sampler;
+  VkDescriptorSetLayout descriptorSetLayout;
+  VkDescriptorPool descriptorPool;
+  VkPipelineLayout pipelineLayout;
+  std::unique_ptr<Pipeline> pipeline;
+
+  VkImage pyramid = VK_NULL_HANDLE;
+  std::vector<VkImageView> levelViews;
+  std::array<FrameResources, SwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+  const FrameResources *testFrame = nullptr;
+
+  // consecutive failed tests per object
+  std::vector<uint8_t> occludedStreaks;
+  uint32_t tested = 0;
+  uint32_t culled = 0;
+};
+
+}  // namespace lve
@@ -1,5 +1,6 @@
 #include "pipeline.h"
 
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -12,29 +13,84 @@ Pipeline::Pipeline(Device& device,
                    std::string vertFilepath,
                    std::string fragFilepath,
                    const PipelineConfigInfo& config)
-    : device{device} {
+    : device{device}, bindPoint{VK_PIPELINE_BIND_POINT_GRAPHICS} {
   createGraphicsPipeline(vertFilepath, fragFilepath, config);
 }
 
+Pipeline::Pipeline(Device& device,
+                   std::string compFilepath,
+                   VkPipelineLayout pipelineLayout,
+                   const ShaderSpecialization& specialization)
+    : device{device}, bindPoint{VK_PIPELINE_BIND_POINT_COMPUTE} {
+  createComputePipeline(compFilepath, pipelineLayout, specialization);
+}
+
 Pipeline::~Pipeline() {
-  vkDestroyShaderModule(device.device(), vertShaderModule, nullptr);
-  vkDestroyShaderModule(device.device(), fragShaderModule, nullptr);
-  vkDestroyPipeline(device.device(), graphicsPipeline, nullptr);
+  std::array<VkShaderModule, 3> shaderModules{
+      vertShaderModule, fragShaderModule, compShaderModule};
+  device.getDeletionQueue().push(
+      [device = device.device(),
+       allocator = device.allocator(),
+       pipeline = pipeline,
+       shaderModules] {
+        for (auto shaderModule : shaderModules) {
+          if (shaderModule != VK_NULL_HANDLE) {
+            vkDestroyShaderModule(device, shaderModule, allocator);
+          }
+        }
+        vkDestroyPipeline(device, pipeline, allocator);
+      });
 }
 
 void Pipeline::bind(VkCommandBuffer commandBuffer) {
-  vkCmdBindPipeline(
-      commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+  if (extendedDynamicState) {
+    bind(commandBuffer, dynamicState);
+    return;
+  }
+  vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+}
+
+void Pipeline::bind(VkCommandBuffer commandBuffer,
+                    const PipelineDynamicState& state) {
+  vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+  device.cmdSetCullMode(commandBuffer, state.cullMode);
+  device.cmdSetFrontFace(commandBuffer, state.frontFace);
+  device.cmdSetPrimitiveTopology(commandBuffer, state.topology);
+  device.cmdSetDepthTestEnable(commandBuffer, state.depthTestEnable);
+  device.cmdSetDepthWriteEnable(commandBuffer, state.depthWriteEnable);
+  device.cmdSetDepthCompareOp(commandBuffer, state.depthCompareOp);
+}
+
+PipelineDynamicState Pipeline::getDynamicState(
+    const PipelineConfigInfo& config) {
+  PipelineDynamicState state{};
+  state.cullMode = config.rasterizationInfo.cullMode;
+  state.frontFace = config.rasterizationInfo.frontFace;
+  state.topology = config.inputAssemblyInfo.topology;
+  state.depthTestEnable = config.depthStencilInfo.depthTestEnable;
+  state.depthWriteEnable = config.depthStencilInfo.depthWriteEnable;
+  state.depthCompareOp = config.depthStencilInfo.depthCompareOp;
+  return state;
 }
 
 void Pipeline::createGraphicsPipeline(std::string vertFilepath,
                                       std::string fragFilepath,
                                       const PipelineConfigInfo& config) {
   auto vertCode = readFile(vertFilepath);
-  auto fragCode = readFile(fragFilepath);
-
   createShaderModule(vertCode, vertShaderModule);
-  createShaderModule(fragCode, fragShaderModule);
+
+  // depth-only pipelines have no fragment stage
+  uint32_t stageCount = 1;
+  if (!fragFilepath.empty()) {
+    auto fragCode = readFile(fragFilepath);
+    createShaderModule(fragCode, fragShaderModule);
+    stageCount = 2;
+  }
+
+  VkSpecializationInfo vertSpecializationInfo =
+      config.vertSpecialization.getInfo();
+  VkSpecializationInfo fragSpecializationInfo =
+      config.fragSpecialization.getInfo();
 
   VkPipelineShaderStageCreateInfo shaderStages[2];
   shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -44,6 +100,9 @@ void Pipeline::createGraphicsPipeline(std::string vertFilepath,
   shaderStages[0].flags = 0;
   shaderStages[0].pNext = nullptr;
   shaderStages[0].pSpecializationInfo = nullptr;
+  if (!config.vertSpecialization.empty()) {
+    shaderStages[0].pSpecializationInfo = &vertSpecializationInfo;
+  }
   shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   shaderStages[1].module = fragShaderModule;
@@ -51,24 +110,15 @@ void Pipeline::createGraphicsPipeline(std::string vertFilepath,
   shaderStages[1].flags = 0;
   shaderStages[1].pNext = nullptr;
   shaderStages[1].pSpecializationInfo = nullptr;
-
-  auto bindDescriptions = Model::Vertex::getBindingDescriptions();
-  auto attributeDescriptions = Model::Vertex::getAttributeDescriptions();
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-  vertexInputInfo.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount =
-      static_cast<uint32_t>(bindDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = bindDescriptions.data();
-  vertexInputInfo.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+  if (!config.fragSpecialization.empty()) {
+    shaderStages[1].pSpecializationInfo = &fragSpecializationInfo;
+  }
 
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
+  pipelineInfo.stageCount = stageCount;
   pipelineInfo.pStages = shaderStages;
-  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pVertexInputState = &config.vertexInputInfo;
   pipelineInfo.pInputAssemblyState = &config.inputAssemblyInfo;
   pipelineInfo.pViewportState = &config.viewportInfo;
   pipelineInfo.pRasterizationState = &config.rasterizationInfo;
@@ -77,10 +127,46 @@ void Pipeline::createGraphicsPipeline(std::string vertFilepath,
   pipelineInfo.pColorBlendState = &config.colorBlendInfo;
   pipelineInfo.pDynamicState = &config.dynamicStateInfo;
 
+  extendedDynamicState =
+      config.useExtendedDynamicState && device.supportsExtendedDynamicState();
+  std::vector<VkDynamicState> dynamicStateEnables;
+  VkPipelineDynamicStateCreateInfo dynamicStateInfo = config.dynamicStateInfo;
+  if (extendedDynamicState) {
+    dynamicState = getDynamicState(config);
+    dynamicStateEnables.assign(
+        config.dynamicStateInfo.pDynamicStates,
+        config.dynamicStateInfo.pDynamicStates +
+            config.dynamicStateInfo.dynamicStateCount);
+    dynamicStateEnables.insert(dynamicStateEnables.end(),
+                               {VK_DYNAMIC_STATE_CULL_MODE_EXT,
+                                VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+                                VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+                                VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+                                VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+                                VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT});
+    dynamicStateInfo.dynamicStateCount =
+        static_cast<uint32_t>(dynamicStateEnables.size());
+    dynamicStateInfo.pDynamicStates = dynamicStateEnables.data();
+    pipelineInfo.pDynamicState = &dynamicStateInfo;
+  }
+
   pipelineInfo.layout = config.pipelineLayout;
   pipelineInfo.renderPass = config.renderPass;
   pipelineInfo.subpass = config.subpass;
 
+  // without a render pass the pipeline only depends on attachment formats
+  VkPipelineRenderingCreateInfoKHR renderingInfo{};
+  if (config.renderPass == VK_NULL_HANDLE) {
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.colorAttachmentCount = config.colorBlendInfo.attachmentCount;
+    renderingInfo.pColorAttachmentFormats = &config.colorAttachmentFormat;
+    renderingInfo.depthAttachmentFormat = config.depthAttachmentFormat;
+    // nothing uses stencil, so no stencil attachment is bound even when the
+    // depth format has one, and the formats have to match that
+    renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+    pipelineInfo.pNext = &renderingInfo;
+  }
+
   pipelineInfo.basePipelineIndex = -1;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
@@ -88,12 +174,56 @@ void Pipeline::createGraphicsPipeline(std::string vertFilepath,
                                 VK_NULL_HANDLE,
                                 1,
                                 &pipelineInfo,
-                                nullptr,
-                                &graphicsPipeline) != VK_SUCCESS) {
+                                device.allocator(),
+                                &pipeline) != VK_SUCCESS) {
     throw std::runtime_error("failed to create graphics pipeline!");
   }
 }
 
+void Pipeline::createComputePipeline(
+    std::string compFilepath,
+    VkPipelineLayout pipelineLayout,
+    const ShaderSpecialization& specialization) {
+  auto compCode = readFile(compFilepath);
+  createShaderModule(compCode, compShaderModule);
+
+  VkSpecializationInfo specializationInfo = specialization.getInfo();
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = compShaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.flags = 0;
+  pipelineInfo.stage.pNext = nullptr;
+  pipelineInfo.stage.pSpecializationInfo =
+      specialization.empty() ? nullptr : &specializationInfo;
+  pipelineInfo.layout = pipelineLayout;
+
+  pipelineInfo.basePipelineIndex = -1;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  if (vkCreateComputePipelines(device.device(),
+                               VK_NULL_HANDLE,
+                               1,
+                               &pipelineInfo,
+                               device.allocator(),
+                               &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+}
+
+VkSpecializationInfo ShaderSpecialization::getInfo() const {
+  VkSpecializationInfo info{};
+  info.mapEntryCount = static_cast<uint32_t>(entries.size());
+  info.pMapEntries = entries.data();
+  info.dataSize = data.size();
+  info.pData = data.data();
+  return info;
+}
+
 std::vector<char> Pipeline::readFile(std::string filepath) {
   std::ifstream file{filepath, std::ios::ate | std::ios::binary};
 
@@ -118,13 +248,17 @@ void Pipeline::createShaderModule(const std::vector<char>& code,
   createInfo.codeSize = code.size();
   createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
-  if (vkCreateShaderModule(
-          device.device(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+  if (vkCreateShaderModule(device.device(),
+                           &createInfo,
+                           device.allocator(),
+                           &shaderModule) != VK_SUCCESS) {
     throw std::runtime_error("failed to create shader module");
   }
 }
 
 void Pipeline::makeDefaultPipelineConfigInfo(PipelineConfigInfo& config) {
+  config.vertexInputInfo = Model::Layout::getInputStateInfo();
+
   config.inputAssemblyInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
   config.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -207,4 +341,17 @@ void Pipeline::makeDefaultPipelineConfigInfo(PipelineConfigInfo& config) {
   config.dynamicStateInfo.flags = 0;
 }
 
+void Pipeline::makeDepthPrepassPipelineConfigInfo(PipelineConfigInfo& config) {
+  makeDefaultPipelineConfigInfo(config);
+  config.vertexInputInfo = Model::PositionOnlyLayout::getInputStateInfo();
+  config.colorBlendInfo.attachmentCount = 0;
+  config.colorBlendInfo.pAttachments = nullptr;
+}
+
+void Pipeline::makeDepthEqualPipelineConfigInfo(PipelineConfigInfo& config) {
+  makeDefaultPipelineConfigInfo(config);
+  config.depthStencilInfo.depthWriteEnable = VK_FALSE;
+  config.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+}
+
 }  // namespace lve
@@ -1,16 +1,83 @@
 #pragma once
 
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "device.h"
 
 namespace lve {
 
+// Specialization constants of one shader stage, as pipelines take them. Fill
+// them in through SpecializationConstants, which checks the mapping against
+// the struct holding the values.
+class ShaderSpecialization {
+ public:
+  ShaderSpecialization() = default;
+
+  bool empty() const { return entries.empty(); }
+  // points into this object, which has to outlive its use
+  VkSpecializationInfo getInfo() const;
+
+ protected:
+  std::vector<char> data;
+  std::vector<VkSpecializationMapEntry> entries;
+};
+
+// Copies the values from a plain struct; map() assigns its members to
+// constant_ids, e.g.
+//   SpecializationConstants<Constants> specialization{constants};
+//   specialization.map(0, &Constants::encodeSrgb);
+// Constants are folded in when the pipeline is created, so a shader can
+// branch on them without runtime cost.
+template <typename T>
+class SpecializationConstants : public ShaderSpecialization {
+ public:
+  explicit SpecializationConstants(const T& constants) : constants{constants} {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "specialization constants must be trivially copyable");
+    data.resize(sizeof(T));
+    std::memcpy(data.data(), &constants, sizeof(T));
+  }
+
+  template <typename U, typename M>
+  SpecializationConstants& map(uint32_t constantId, M U::*member) {
+    static_assert(std::is_same<U, T>::value,
+                  "specialization constant is not a member of the constants");
+    // SPIR-V bools are 32 bits wide, so bool members are rejected too
+    static_assert(
+        std::is_scalar<M>::value && (sizeof(M) == 4 || sizeof(M) == 8),
+        "specialization constants must be 4 or 8 byte scalars");
+    auto offset = reinterpret_cast<const char*>(&(constants.*member)) -
+                  reinterpret_cast<const char*>(&constants);
+    entries.push_back({constantId, static_cast<uint32_t>(offset), sizeof(M)});
+    return *this;
+  }
+
+ private:
+  // only used to find the members
+  T constants;
+};
+
+// Rasterizer and depth state that pipelines created with
+// useExtendedDynamicState take from the command buffer instead. The topology
+// can only change within the class of the baked one, e.g. between lists and
+// strips of triangles.
+struct PipelineDynamicState {
+  VkCullModeFlags cullMode;
+  VkFrontFace frontFace;
+  VkPrimitiveTopology topology;
+  VkBool32 depthTestEnable;
+  VkBool32 depthWriteEnable;
+  VkCompareOp depthCompareOp;
+};
+
 struct PipelineConfigInfo {
   PipelineConfigInfo(const PipelineConfigInfo&) = delete;
   PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo;
   VkPipelineViewportStateCreateInfo viewportInfo;
   VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
   VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -23,6 +90,14 @@ struct PipelineConfigInfo {
   VkPipelineLayout pipelineLayout = nullptr;
   VkRenderPass renderPass = nullptr;
   uint32_t subpass = 0;
+  // used instead of renderPass/subpass for dynamic rendering
+  VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+  VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+  // makes the PipelineDynamicState dynamic when the device supports extended
+  // dynamic state, so configs that only differ in it can share one pipeline
+  bool useExtendedDynamicState = false;
+  ShaderSpecialization vertSpecialization;
+  ShaderSpecialization fragSpecialization;
 };
 
 class Pipeline {
@@ -31,15 +106,31 @@ class Pipeline {
            std::string vertFilepath,
            std::string fragFilepath,
            const PipelineConfigInfo& config);
+  Pipeline(Device& device,
+           std::string compFilepath,
+           VkPipelineLayout pipelineLayout,
+           const ShaderSpecialization& specialization = {});
 
   ~Pipeline();
 
   Pipeline(const Pipeline&) = delete;
   Pipeline& operator=(const Pipeline&) = delete;
 
+  // also sets the config's PipelineDynamicState if it is dynamic
   void bind(VkCommandBuffer commandBuffer);
+  // requires usesExtendedDynamicState()
+  void bind(VkCommandBuffer commandBuffer, const PipelineDynamicState& state);
 
   static void makeDefaultPipelineConfigInfo(PipelineConfigInfo& config);
+  // position-only, no color attachments; pair with an empty fragFilepath
+  static void makeDepthPrepassPipelineConfigInfo(PipelineConfigInfo& config);
+  // shades only the fragments left by a depth prepass, without depth writes
+  static void makeDepthEqualPipelineConfigInfo(PipelineConfigInfo& config);
+
+  static PipelineDynamicState getDynamicState(const PipelineConfigInfo& config);
+
+  VkPipelineBindPoint getBindPoint() const { return bindPoint; }
+  bool usesExtendedDynamicState() const { return extendedDynamicState; }
 
  private:
   static std::vector<char> readFile(std::string filepath);
@@ -47,14 +138,21 @@ class Pipeline {
   void createGraphicsPipeline(std::string vertFilepath,
                               std::string fragFilepath,
                               const PipelineConfigInfo& config);
+  void createComputePipeline(std::string compFilepath,
+                             VkPipelineLayout pipelineLayout,
+                             const ShaderSpecialization& specialization);
 
   void createShaderModule(const std::vector<char>& code,
                           VkShaderModule& shaderModule);
 
   Device& device;
-  VkPipeline graphicsPipeline;
-  VkShaderModule vertShaderModule;
-  VkShaderModule fragShaderModule;
+  VkPipeline pipeline;
+  VkPipelineBindPoint bindPoint;
+  bool extendedDynamicState = false;
+  PipelineDynamicState dynamicState{};
+  VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+  VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+  VkShaderModule compShaderModule = VK_NULL_HANDLE;
 };
 
 }  // namespace lve
@@ -0,0 +1,600 @@
+#include "render_graph.h"
+
+// std headers
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+struct AccessInfo {
+  VkPipelineStageFlags stage;
+  VkAccessFlags access;
+  VkImageLayout layout;
+  bool write;
+};
+
+static AccessInfo getAccessInfo(RenderGraphAccess access) {
+  switch (access) {
+    case RenderGraphAccess::ColorAttachmentWrite:
+      return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              true};
+    case RenderGraphAccess::DepthAttachmentWrite:
+      return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+              true};
+    case RenderGraphAccess::ComputeDepthRead:
+      return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+              false};
+    case RenderGraphAccess::ComputeSampledRead:
+      return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              false};
+    case RenderGraphAccess::ComputeStorageWrite:
+      return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_GENERAL,
+              true};
+    case RenderGraphAccess::TransferRead:
+      return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_READ_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+              false};
+    case RenderGraphAccess::TransferWrite:
+      return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+              true};
+    case RenderGraphAccess::HostRead:
+      return {VK_PIPELINE_STAGE_HOST_BIT,
+              VK_ACCESS_HOST_READ_BIT,
+              VK_IMAGE_LAYOUT_GENERAL,
+              false};
+    // the stage the acquire semaphore is waited on, so the next frame's
+    // transition chains with it
+    case RenderGraphAccess::Present:
+      return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+              0,
+              VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+              false};
+  }
+  throw std::runtime_error("unknown render graph access!");
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::use(
+    RenderGraphResource resource, RenderGraphAccess access) {
+  graph.passes[pass].uses.push_back({resource, access, false});
+  return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::attachment(
+    RenderGraphResource resource, RenderGraphAccess access) {
+  graph.passes[pass].uses.push_back({resource, access, true});
+  return *this;
+}
+
+RenderGraph::RenderGraph(Device &device) : device{device} {}
+
+RenderGraph::~RenderGraph() {
+  std::vector<VkImage> images;
+  std::vector<VkBuffer> buffers;
+  std::vector<VkDeviceMemory> memories;
+  for (auto &resource : resources) {
+    if (resource.imported) {
+      continue;
+    }
+    if (resource.image != VK_NULL_HANDLE) {
+      images.push_back(resource.image);
+    }
+    if (resource.buffer != VK_NULL_HANDLE) {
+      buffers.push_back(resource.buffer);
+    }
+  }
+  for (auto &block : memoryBlocks) {
+    memories.push_back(block.memory);
+  }
+
+  device.getDeletionQueue().push(
+      [device = device.device(),
+       allocator = device.allocator(),
+       images,
+       buffers,
+       memories] {
+        for (auto image : images) {
+          vkDestroyImage(device, image, allocator);
+        }
+        for (auto buffer : buffers) {
+          vkDestroyBuffer(device, buffer, allocator);
+        }
+        for (auto memory : memories) {
+          vkFreeMemory(device, memory, allocator);
+        }
+      });
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string &name,
+                                             VkImageAspectFlags aspect,
+                                             bool discard) {
+  Resource resource{};
+  resource.name = name;
+  resource.isImage = true;
+  resource.imported = true;
+  resource.discard = discard;
+  resource.aspect = aspect;
+  resources.push_back(resource);
+  return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string &name) {
+  Resource resource{};
+  resource.name = name;
+  resource.isImage = false;
+  resource.imported = true;
+  resources.push_back(resource);
+  return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string &name,
+                                             const VkImageCreateInfo &imageInfo,
+                                             VkImageAspectFlags aspect) {
+  Resource resource{};
+  resource.name = name;
+  resource.isImage = true;
+  resource.imported = false;
+  resource.aspect = aspect;
+  resource.imageInfo = imageInfo;
+  resources.push_back(resource);
+  return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createBuffer(
+    const std::string &name, const VkBufferCreateInfo &bufferInfo) {
+  Resource resource{};
+  resource.name = name;
+  resource.isImage = false;
+  resource.imported = false;
+  resource.bufferInfo = bufferInfo;
+  resources.push_back(resource);
+  return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(
+    const std::string &name, std::function<void(VkCommandBuffer)> execute) {
+  Pass pass{};
+  pass.name = name;
+  pass.execute = std::move(execute);
+  passes.push_back(std::move(pass));
+  return PassBuilder{*this, static_cast<uint32_t>(passes.size() - 1)};
+}
+
+void RenderGraph::markOutput(RenderGraphResource resource) {
+  resources[resource].output = true;
+}
+
+void RenderGraph::markOutput(RenderGraphResource resource,
+                             RenderGraphAccess finalAccess) {
+  resources[resource].output = true;
+  resources[resource].hasFinalAccess = true;
+  resources[resource].finalAccess = finalAccess;
+}
+
+void RenderGraph::compile() {
+  if (compiled) {
+    throw std::runtime_error("render graph compiled twice!");
+  }
+
+  cullPasses();
+  allocateTransients();
+
+  // the first run starts from nothing and ends in the state every later
+  // frame starts from
+  std::vector<ResourceState> states(resources.size());
+  std::vector<VkPipelineStageFlags> blockStages(memoryBlocks.size(), 0);
+  planBarriers(states, blockStages);
+  planBarriers(states, blockStages);
+
+  for (const auto &pass : passes) {
+    if (pass.culled) {
+      statistics.culledPassCount++;
+      continue;
+    }
+    statistics.passCount++;
+    countBarriers(pass.barriers);
+  }
+  countBarriers(finalBarriers);
+
+  compiled = true;
+}
+
+void RenderGraph::cullPasses() {
+  std::vector<bool> needed(resources.size(), false);
+  for (size_t i = 0; i < resources.size(); i++) {
+    needed[i] = resources[i].output;
+  }
+
+  for (size_t i = passes.size(); i-- > 0;) {
+    auto &pass = passes[i];
+    pass.culled = true;
+    for (const auto &use : pass.uses) {
+      if (getAccessInfo(use.access).write && needed[use.resource]) {
+        pass.culled = false;
+      }
+    }
+    if (pass.culled) {
+      continue;
+    }
+    for (const auto &use : pass.uses) {
+      needed[use.resource] = true;
+    }
+  }
+
+  for (int i = 0; i < static_cast<int>(passes.size()); i++) {
+    if (passes[i].culled) {
+      continue;
+    }
+    for (const auto &use : passes[i].uses) {
+      auto &resource = resources[use.resource];
+      if (resource.firstPass < 0) {
+        resource.firstPass = i;
+      }
+      resource.lastPass = i;
+    }
+  }
+}
+
+void RenderGraph::allocateTransients() {
+  std::vector<RenderGraphResource> transients;
+  std::vector<VkMemoryRequirements> requirements(resources.size());
+
+  for (RenderGraphResource i = 0; i < resources.size(); i++) {
+    auto &resource = resources[i];
+    if (resource.imported || resource.firstPass < 0) {
+      continue;
+    }
+
+    if (resource.isImage) {
+      if (vkCreateImage(device.device(),
+                        &resource.imageInfo,
+                        device.allocator(),
+                        &resource.image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+      }
+      vkGetImageMemoryRequirements(
+          device.device(), resource.image, &requirements[i]);
+    } else {
+      if (vkCreateBuffer(device.device(),
+                         &resource.bufferInfo,
+                         device.allocator(),
+                         &resource.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+      }
+      vkGetBufferMemoryRequirements(
+          device.device(), resource.buffer, &requirements[i]);
+    }
+    statistics.transientBytes += requirements[i].size;
+    transients.push_back(i);
+  }
+
+  // largest first, each into the first block none of whose resources is
+  // alive at the same time
+  std::sort(transients.begin(),
+            transients.end(),
+            [&](RenderGraphResource a, RenderGraphResource b) {
+              return requirements[a].size > requirements[b].size;
+            });
+
+  for (auto i : transients) {
+    auto &resource = resources[i];
+    const auto &req = requirements[i];
+
+    for (size_t b = 0; b < memoryBlocks.size() && resource.memoryBlock < 0;
+         b++) {
+      auto &block = memoryBlocks[b];
+      if ((block.memoryTypeBits & req.memoryTypeBits) == 0) {
+        continue;
+      }
+      bool overlaps = false;
+      for (auto other : block.resources) {
+        if (resources[other].firstPass <= resource.lastPass &&
+            resource.firstPass <= resources[other].lastPass) {
+          overlaps = true;
+        }
+      }
+      if (!overlaps) {
+        resource.memoryBlock = static_cast<int>(b);
+      }
+    }
+
+    if (resource.memoryBlock < 0) {
+      memoryBlocks.push_back({});
+      resource.memoryBlock = static_cast<int>(memoryBlocks.size() - 1);
+    }
+
+    auto &block = memoryBlocks[resource.memoryBlock];
+    block.size = std::max(block.size, req.size);
+    block.alignment = std::max(block.alignment, req.alignment);
+    block.memoryTypeBits &= req.memoryTypeBits;
+    block.resources.push_back(i);
+  }
+
+  VkDeviceSize allocatedBytes = 0;
+  for (auto &block : memoryBlocks) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = block.size;
+    allocInfo.memoryTypeIndex = device.findMemoryType(
+        block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(
+            device.device(), &allocInfo, device.allocator(), &block.memory) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate render graph memory!");
+    }
+    allocatedBytes += block.size;
+
+    for (auto i : block.resources) {
+      auto &resource = resources[i];
+      VkResult result =
+          resource.isImage
+              ? vkBindImageMemory(
+                    device.device(), resource.image, block.memory, 0)
+              : vkBindBufferMemory(
+                    device.device(), resource.buffer, block.memory, 0);
+      if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind render graph memory!");
+      }
+    }
+  }
+  statistics.aliasedBytes = statistics.transientBytes - allocatedBytes;
+}
+
+void RenderGraph::planBarriers(
+    std::vector<ResourceState> &states,
+    std::vector<VkPipelineStageFlags> &blockStages) {
+  std::vector<bool> used(resources.size(), false);
+
+  for (auto &pass : passes) {
+    pass.barriers.clear();
+    if (pass.culled) {
+      continue;
+    }
+    for (const auto &use : pass.uses) {
+      Barrier barrier{};
+      bool needed = false;
+      planUse(barrier,
+              needed,
+              use.resource,
+              use.access,
+              !used[use.resource],
+              states,
+              blockStages);
+      used[use.resource] = true;
+      if (needed && !use.renderPassAttachment) {
+        pass.barriers.push_back(barrier);
+      }
+    }
+  }
+
+  finalBarriers.clear();
+  for (RenderGraphResource i = 0; i < resources.size(); i++) {
+    if (!resources[i].hasFinalAccess || !used[i]) {
+      continue;
+    }
+    Barrier barrier{};
+    bool needed = false;
+    planUse(barrier,
+            needed,
+            i,
+            resources[i].finalAccess,
+            false,
+            states,
+            blockStages);
+    if (needed) {
+      finalBarriers.push_back(barrier);
+    }
+  }
+}
+
+void RenderGraph::planUse(Barrier &barrier,
+                          bool &needed,
+                          RenderGraphResource resource,
+                          RenderGraphAccess access,
+                          bool firstUse,
+                          std::vector<ResourceState> &states,
+                          std::vector<VkPipelineStageFlags> &blockStages) {
+  AccessInfo info = getAccessInfo(access);
+  const auto &desc = resources[resource];
+  auto &state = states[resource];
+  // host accesses are ordered against the submit by the frame fence
+  const VkPipelineStageFlags deviceStages = ~VK_PIPELINE_STAGE_HOST_BIT;
+
+  // transient contents never survive a frame, so their first use only has to
+  // wait for whatever used the memory before
+  bool discard = firstUse && (!desc.imported || desc.discard);
+  VkImageLayout oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+  bool layoutChange = desc.isImage && oldLayout != info.layout;
+
+  barrier.resource = resource;
+  barrier.dstStage = info.stage;
+  barrier.dstAccess = info.access;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = desc.isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (discard) {
+    VkPipelineStageFlags previousStages =
+        desc.imported ? state.writeStage | state.readStages
+                      : blockStages[desc.memoryBlock];
+    barrier.srcStage = previousStages & deviceStages;
+    barrier.srcAccess = 0;
+    needed = layoutChange || barrier.srcStage != 0;
+  } else if (info.write || layoutChange) {
+    barrier.srcStage = (state.writeStage | state.readStages) & deviceStages;
+    barrier.srcAccess = state.writeAccess;
+    needed = layoutChange || barrier.srcStage != 0;
+  } else {
+    bool visible = (info.stage & ~state.visibleStages) == 0 &&
+                   (info.access & ~state.visibleAccess) == 0;
+    barrier.srcStage = state.writeStage & deviceStages;
+    barrier.srcAccess = state.writeAccess;
+    needed = barrier.srcStage != 0 && !visible;
+  }
+
+  if (info.write || layoutChange) {
+    // a layout transition acts as a write later readers have to wait for
+    state = ResourceState{};
+    state.writeStage = info.stage;
+    state.writeAccess = info.write ? info.access : 0;
+    state.layout = desc.isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    state.readStages = info.write ? 0 : info.stage;
+    state.visibleStages = info.stage;
+    state.visibleAccess = info.access;
+  } else {
+    state.readStages |= info.stage;
+    if (needed) {
+      state.visibleStages |= info.stage;
+      state.visibleAccess |= info.access;
+    }
+  }
+
+  // the host only reads after waiting for the frame, which orders all device
+  // work before it
+  if (info.stage == VK_PIPELINE_STAGE_HOST_BIT) {
+    state.writeStage = 0;
+    state.writeAccess = 0;
+    state.readStages = 0;
+  }
+
+  if (!desc.imported) {
+    VkPipelineStageFlags &blockStage = blockStages[desc.memoryBlock];
+    blockStage = (discard ? 0 : blockStage) | info.stage;
+  }
+}
+
+void RenderGraph::countBarriers(const std::vector<Barrier> &barriers) {
+  if (barriers.empty()) {
+    return;
+  }
+  statistics.barrierBatchCount++;
+  for (const auto &barrier : barriers) {
+    if (resources[barrier.resource].isImage) {
+      statistics.imageBarrierCount++;
+    } else {
+      statistics.bufferBarrierCount++;
+    }
+  }
+}
+
+void RenderGraph::bindImage(RenderGraphResource resource, VkImage image) {
+  resources[resource].image = image;
+}
+
+void RenderGraph::bindBuffer(RenderGraphResource resource, VkBuffer buffer) {
+  resources[resource].buffer = buffer;
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource) const {
+  return resources[resource].image;
+}
+
+VkBuffer RenderGraph::getBuffer(RenderGraphResource resource) const {
+  return resources[resource].buffer;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer,
+                          std::pmr::memory_resource *scratch) {
+  if (!compiled) {
+    throw std::runtime_error("render graph executed before compile!");
+  }
+
+  for (auto &pass : passes) {
+    if (pass.culled) {
+      continue;
+    }
+    recordBarriers(commandBuffer, pass.barriers, scratch);
+    pass.execute(commandBuffer);
+  }
+  recordBarriers(commandBuffer, finalBarriers, scratch);
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+                                 const std::vector<Barrier> &barriers,
+                                 std::pmr::memory_resource *scratch) {
+  if (barriers.empty()) {
+    return;
+  }
+
+  std::pmr::vector<VkImageMemoryBarrier> imageBarriers{scratch};
+  std::pmr::vector<VkBufferMemoryBarrier> bufferBarriers{scratch};
+  imageBarriers.reserve(barriers.size());
+  bufferBarriers.reserve(barriers.size());
+  VkPipelineStageFlags srcStage = 0;
+  VkPipelineStageFlags dstStage = 0;
+
+  for (const auto &barrier : barriers) {
+    const auto &resource = resources[barrier.resource];
+    srcStage |= barrier.srcStage;
+    dstStage |= barrier.dstStage;
+
+    if (resource.isImage) {
+      if (resource.image == VK_NULL_HANDLE) {
+        throw std::runtime_error("render graph image not bound: " +
+                                 resource.name);
+      }
+      VkImageMemoryBarrier imageBarrier{};
+      imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      imageBarrier.srcAccessMask = barrier.srcAccess;
+      imageBarrier.dstAccessMask = barrier.dstAccess;
+      imageBarrier.oldLayout = barrier.oldLayout;
+      imageBarrier.newLayout = barrier.newLayout;
+      imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageBarrier.image = resource.image;
+      imageBarrier.subresourceRange = {resource.aspect,
+                                       0,
+                                       VK_REMAINING_MIP_LEVELS,
+                                       0,
+                                       VK_REMAINING_ARRAY_LAYERS};
+      imageBarriers.push_back(imageBarrier);
+    } else {
+      if (resource.buffer == VK_NULL_HANDLE) {
+        throw std::runtime_error("render graph buffer not bound: " +
+                                 resource.name);
+      }
+      VkBufferMemoryBarrier bufferBarrier{};
+      bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      bufferBarrier.srcAccessMask = barrier.srcAccess;
+      bufferBarrier.dstAccessMask = barrier.dstAccess;
+      bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bufferBarrier.buffer = resource.buffer;
+      bufferBarrier.offset = 0;
+      bufferBarrier.size = VK_WHOLE_SIZE;
+      bufferBarriers.push_back(bufferBarrier);
+    }
+  }
+
+  if (srcStage == 0) {
+    srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  }
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       srcStage,
+                       dstStage,
+                       0,
+                       0,
+                       nullptr,
+                       static_cast<uint32_t>(bufferBarriers.size()),
+                       bufferBarriers.data(),
+                       static_cast<uint32_t>(imageBarriers.size()),
+                       imageBarriers.data());
+}
+
+}  // namespace lve
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "device.h"
+
+// std lib headers
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+using RenderGraphResource = uint32_t;
+
+// How a pass touches a resource; each maps to a pipeline stage, access mask
+// and image layout.
+enum class RenderGraphAccess {
+  ColorAttachmentWrite,
+  DepthAttachmentWrite,
+  ComputeDepthRead,
+  ComputeSampledRead,
+  ComputeStorageWrite,
+  TransferRead,
+  TransferWrite,
+  HostRead,
+  Present,
+};
+
+// Frame graph for one frame's passes.
+//
+// Passes declare the resources they use and are compiled once per
+// configuration: passes that do not contribute to an output are culled,
+// transient resources whose pass ranges do not overlap share memory, and the
+// barriers between passes are precomputed and batched into one
+// vkCmdPipelineBarrier per pass. Every frame starts from the state the
+// previous frame left its resources in, so imported resources have to be in
+// their end-of-frame state when execute() is called and transient contents
+// never survive a frame.
+//
+// Attachments of a VkRenderPass are declared with attachment(); the render
+// pass's own dependencies and layouts synchronize them, the graph only keeps
+// track of their state.
+class RenderGraph {
+ public:
+  struct Statistics {
+    uint32_t passCount = 0;
+    uint32_t culledPassCount = 0;
+    uint32_t barrierBatchCount = 0;
+    uint32_t imageBarrierCount = 0;
+    uint32_t bufferBarrierCount = 0;
+    VkDeviceSize transientBytes = 0;
+    VkDeviceSize aliasedBytes = 0;
+  };
+
+  class PassBuilder {
+   public:
+    PassBuilder(RenderGraph &graph, uint32_t pass)
+        : graph{graph}, pass{pass} {}
+
+    PassBuilder &use(RenderGraphResource resource, RenderGraphAccess access);
+    PassBuilder &attachment(RenderGraphResource resource,
+                            RenderGraphAccess access);
+
+   private:
+    RenderGraph &graph;
+    uint32_t pass;
+  };
+
+  RenderGraph(Device &device);
+  ~RenderGraph();
+
+  RenderGraph(const RenderGraph &) = delete;
+  RenderGraph &operator=(const RenderGraph &) = delete;
+
+  // Imported handles can change every frame; see bindImage/bindBuffer.
+  // Discarded images are transitioned from UNDEFINED on their first use,
+  // e.g. attachments that are cleared every frame.
+  RenderGraphResource importImage(const std::string &name,
+                                  VkImageAspectFlags aspect,
+                                  bool discard = false);
+  RenderGraphResource importBuffer(const std::string &name);
+  RenderGraphResource createImage(const std::string &name,
+                                  const VkImageCreateInfo &imageInfo,
+                                  VkImageAspectFlags aspect);
+  RenderGraphResource createBuffer(const std::string &name,
+                                   const VkBufferCreateInfo &bufferInfo);
+
+  PassBuilder addPass(const std::string &name,
+                      std::function<void(VkCommandBuffer)> execute);
+
+  // Keeps the passes writing the resource alive; finalAccess is where the
+  // resource is made available after the last pass.
+  void markOutput(RenderGraphResource resource);
+  void markOutput(RenderGraphResource resource, RenderGraphAccess finalAccess);
+
+  void compile();
+
+  void bindImage(RenderGraphResource resource, VkImage image);
+  void bindBuffer(RenderGraphResource resource, VkBuffer buffer);
+  // the barrier arrays are allocated from scratch
+  void execute(
+      VkCommandBuffer commandBuffer,
+      std::pmr::memory_resource *scratch = std::pmr::get_default_resource());
+
+  // VK_NULL_HANDLE for transient resources only used by culled passes
+  VkImage getImage(RenderGraphResource resource) const;
+  VkBuffer getBuffer(RenderGraphResource resource) const;
+  const Statistics &getStatistics() const { return statistics; }
+
+ private:
+  struct Resource {
+    std::string name;
+    bool isImage;
+    bool imported;
+    bool discard = false;
+    VkImageAspectFlags aspect = 0;
+    VkImageCreateInfo imageInfo{};
+    VkBufferCreateInfo bufferInfo{};
+    VkImage image = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    bool output = false;
+    bool hasFinalAccess = false;
+    RenderGraphAccess finalAccess;
+    int firstPass = -1;
+    int lastPass = -1;
+    int memoryBlock = -1;
+  };
+
+  struct Use {
+    RenderGraphResource resource;
+    RenderGraphAccess access;
+    bool renderPassAttachment;
+  };
+
+  struct Barrier {
+    RenderGraphResource resource;
+    VkPipelineStageFlags srcStage;
+    VkPipelineStageFlags dstStage;
+    VkAccessFlags srcAccess;
+    VkAccessFlags dstAccess;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<Use> uses;
+    std::function<void(VkCommandBuffer)> execute;
+    bool culled = false;
+    std::vector<Barrier> barriers;
+  };
+
+  struct ResourceState {
+    VkPipelineStageFlags writeStage = 0;
+    VkAccessFlags writeAccess = 0;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags readStages = 0;
+    VkPipelineStageFlags visibleStages = 0;
+    VkAccessFlags visibleAccess = 0;
+  };
+
+  struct MemoryBlock {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    VkDeviceSize alignment = 1;
+    uint32_t memoryTypeBits = ~0u;
+    std::vector<RenderGraphResource> resources;
+  };
+
+  void cullPasses();
+  void allocateTransients();
+  // fills the pass barriers starting from the given states and leaves them
+  // at their end-of-frame values
+  void planBarriers(std::vector<ResourceState> &states,
+                    std::vector<VkPipelineStageFlags> &blockStages);
+  void planUse(Barrier &barrier,
+               bool &needed,
+               RenderGraphResource resource,
+               RenderGraphAccess access,
+               bool firstUse,
+               std::vector<ResourceState> &states,
+               std::vector<VkPipelineStageFlags> &blockStages);
+  void recordBarriers(VkCommandBuffer commandBuffer,
+                      const std::vector<Barrier> &barriers,
+                      std::pmr::memory_resource *scratch);
+  void countBarriers(const std::vector<Barrier> &barriers);
+
+  Device &device;
+  std::vector<Resource> resources;
+  std::vector<Pass> passes;
+  std::vector<Barrier> finalBarriers;
+  std::vector<MemoryBlock> memoryBlocks;
+  bool compiled = false;
+  Statistics statistics;
+};
+
+}  // namespace lve
@@ -0,0 +1,71 @@
+#include "sampler_cache.h"
+
+// std lib headers
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+SamplerCache::SamplerCache(Device &device) : device{device} {}
+
+SamplerCache::~SamplerCache() {
+  for (auto &entry : samplers) {
+    vkDestroySampler(device.device(), entry.second, device.allocator());
+  }
+}
+
+VkSampler SamplerCache::getSampler(const VkSamplerCreateInfo &samplerInfo) {
+  VkSamplerCreateInfo info = samplerInfo;
+  info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  info.pNext = nullptr;
+  info.flags = 0;
+  if (info.anisotropyEnable) {
+    info.maxAnisotropy = std::min(
+        info.maxAnisotropy, device.properties.limits.maxSamplerAnisotropy);
+  } else {
+    info.maxAnisotropy = 1.0f;
+  }
+  // unused state must not split otherwise identical samplers
+  if (!info.compareEnable) {
+    info.compareOp = VK_COMPARE_OP_NEVER;
+  }
+
+  Key key = makeKey(info);
+  auto cached = samplers.find(key);
+  if (cached != samplers.end()) {
+    return cached->second;
+  }
+
+  if (samplers.size() >= device.properties.limits.maxSamplerAllocationCount) {
+    throw std::runtime_error(
+        "failed to create sampler, maxSamplerAllocationCount reached!");
+  }
+
+  VkSampler sampler;
+  if (vkCreateSampler(device.device(), &info, device.allocator(), &sampler) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create sampler!");
+  }
+  samplers.emplace(key, sampler);
+  return sampler;
+}
+
+SamplerCache::Key SamplerCache::makeKey(const VkSamplerCreateInfo &info) {
+  return Key{info.magFilter,
+             info.minFilter,
+             info.mipmapMode,
+             info.addressModeU,
+             info.addressModeV,
+             info.addressModeW,
+             info.mipLodBias,
+             info.anisotropyEnable,
+             info.maxAnisotropy,
+             info.compareEnable,
+             info.compareOp,
+             info.minLod,
+             info.maxLod,
+             info.borderColor,
+             info.unnormalizedCoordinates};
+}
+
+}  // namespace lve
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "device.h"
+
+// std lib headers
+#include <map>
+#include <tuple>
+
+namespace lve {
+
+// Hands out one VkSampler per distinct sampler state, shared by everyone who
+// asks for it. Devices cap how many samplers may exist at once
+// (maxSamplerAllocationCount, which can be as low as 4000), so samplers are
+// requested here rather than created per texture. They live as long as the
+// cache.
+class SamplerCache {
+ public:
+  SamplerCache(Device &device);
+  ~SamplerCache();
+
+  SamplerCache(const SamplerCache &) = delete;
+  SamplerCache &operator=(const SamplerCache &) = delete;
+
+  // pNext and flags are ignored; maxAnisotropy is clamped to the device limit
+  VkSampler getSampler(const VkSamplerCreateInfo &samplerInfo);
+
+  size_t size() const { return samplers.size(); }
+
+ private:
+  using Key = std::tuple<VkFilter,
+                         VkFilter,
+                         VkSamplerMipmapMode,
+                         VkSamplerAddressMode,
+                         VkSamplerAddressMode,
+                         VkSamplerAddressMode,
+                         float,
+                         VkBool32,
+                         float,
+                         VkBool32,
+                         VkCompareOp,
+                         float,
+                         float,
+                         VkBorderColor,
+                         VkBool32>;
+
+  static Key makeKey(const VkSamplerCreateInfo &samplerInfo);
+
+  Device &device;
+  std::map<Key, VkSampler> samplers;
+};
+
+}  // namespace lve
@@ -0,0 +1,141 @@
+#include "shader_watcher.h"
+
+#include "logger.h"
+
+// std lib headers
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <stdexcept>
+
+// posix headers
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace lve {
+
+// how often the watch thread checks whether it should stop
+constexpr int POLL_TIMEOUT_MS = 100;
+
+ShaderWatcher::ShaderWatcher(std::string directory,
+                             std::function<void()> onUpdate)
+    : directory{std::move(directory)}, onUpdate{std::move(onUpdate)} {
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd < 0) {
+    throw std::runtime_error("failed to initialize inotify!");
+  }
+
+  // editors either rewrite the file in place or rename a temporary over it
+  if (inotify_add_watch(inotifyFd,
+                        this->directory.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(inotifyFd);
+    throw std::runtime_error("failed to watch shader directory " +
+                             this->directory);
+  }
+
+  thread = std::thread{&ShaderWatcher::watch, this};
+}
+
+ShaderWatcher::~ShaderWatcher() {
+  stopping = true;
+  thread.join();
+  close(inotifyFd);
+}
+
+std::vector<std::string> ShaderWatcher::takeUpdatedShaders() {
+  std::lock_guard<std::mutex> lock{updatedMutex};
+  std::vector<std::string> updated;
+  updated.swap(updatedShaders);
+  return updated;
+}
+
+void ShaderWatcher::watch() {
+  alignas(inotify_event) char buffer[4096];
+  pollfd pollFd{inotifyFd, POLLIN, 0};
+
+  while (!stopping) {
+    if (poll(&pollFd, 1, POLL_TIMEOUT_MS) <= 0) {
+      continue;
+    }
+
+    // one save usually produces several events for the same file
+    std::set<std::string> changed;
+    ssize_t length;
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+      for (char *next = buffer; next < buffer + length;) {
+        auto event = reinterpret_cast<const inotify_event *>(next);
+        if (event->len > 0 && isShaderSource(event->name)) {
+          changed.insert(event->name);
+        }
+        next += sizeof(inotify_event) + event->len;
+      }
+    }
+
+    bool updated = false;
+    for (const auto &name : changed) {
+      if (compile(name)) {
+        std::lock_guard<std::mutex> lock{updatedMutex};
+        if (std::find(updatedShaders.begin(), updatedShaders.end(), name) ==
+            updatedShaders.end()) {
+          updatedShaders.push_back(name);
+        }
+        updated = true;
+      }
+    }
+    if (updated && onUpdate) {
+      onUpdate();
+    }
+  }
+}
+
+bool ShaderWatcher::compile(const std::string &name) {
+  std::string source = directory + "/" + name;
+  std::string target = source + ".spv";
+  std::string temporary = target + ".tmp";
+  std::string command =
+      "glslc '" + source + "' -o '" + temporary + "' 2>&1";
+
+  FILE *process = popen(command.c_str(), "r");
+  if (process == nullptr) {
+    LogMessage{LogSeverity::Error} << "Failed to run glslc for " << name;
+    return false;
+  }
+
+  std::string output;
+  char line[256];
+  while (fgets(line, sizeof(line), process) != nullptr) {
+    output += line;
+  }
+  int status = pclose(process);
+
+  if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::remove(temporary.c_str());
+    LogMessage{LogSeverity::Error} << "Failed to compile " << name
+                                   << ", keeping the previous version:\n"
+                                   << output;
+    return false;
+  }
+
+  if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    LogMessage{LogSeverity::Error} << "Failed to replace " << target;
+    return false;
+  }
+
+  LogMessage{LogSeverity::Info} << "Recompiled " << name;
+  return true;
+}
+
+bool ShaderWatcher::isShaderSource(const std::string &name) {
+  auto dot = name.rfind('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  auto extension = name.substr(dot);
+  return extension == ".vert" || extension == ".frag" || extension == ".comp";
+}
+
+}  // namespace lve
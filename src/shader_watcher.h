@@ -0,0 +1,52 @@
+#pragma once
+
+// std lib headers
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lve {
+
+// Recompiles the GLSL sources of a directory when they change on disk.
+//
+// A background thread waits for inotify events on the directory and runs
+// glslc for every .vert, .frag or .comp file that was written, replacing
+// "<name>.spv" next to the source with a rename so pipelines never load a
+// partially written file. Sources that fail to compile leave their old SPIR-V
+// untouched and print glslc's output instead, so the running pipelines stay
+// in use until the error is fixed.
+class ShaderWatcher {
+ public:
+  // onUpdate is called from the watch thread after a shader was recompiled,
+  // e.g. to wake a main loop blocked waiting for events
+  ShaderWatcher(std::string directory,
+                std::function<void()> onUpdate = nullptr);
+  ~ShaderWatcher();
+
+  ShaderWatcher(const ShaderWatcher &) = delete;
+  ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+  // File names of the sources recompiled since the last call, e.g.
+  // "simple_shader.frag"; never blocks on a compile in progress.
+  std::vector<std::string> takeUpdatedShaders();
+
+ private:
+  void watch();
+  bool compile(const std::string &name);
+
+  static bool isShaderSource(const std::string &name);
+
+  std::string directory;
+  std::function<void()> onUpdate;
+  int inotifyFd = -1;
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+
+  std::mutex updatedMutex;
+  std::vector<std::string> updatedShaders;
+};
+
+}  // namespace lve
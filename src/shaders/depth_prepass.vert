@@ -0,0 +1,16 @@
+#version 450
+
+layout(location = 0) in vec2 position;
+
+layout(push_constant) uniform Push {
+  vec2 positionScale;
+  vec2 positionOffset;
+} push;
+
+// must match simple_shader.vert bit for bit for the EQUAL depth test
+invariant gl_Position;
+
+void main() {
+  gl_Position =
+      vec4(position * push.positionScale + push.positionOffset, 0.0, 1.0);
+}
@@ -1,9 +1,22 @@
 #version 450
 
+// set when the swapchain format does not encode to sRGB itself
+layout(constant_id = 0) const bool ENCODE_SRGB = false;
+
 layout (location = 0) in vec3 fragColor;
 
 layout (location = 0) out vec4 outColor;
 
+vec3 encodeSrgb(vec3 linear) {
+  vec3 low = linear * 12.92;
+  vec3 high = 1.055 * pow(linear, vec3(1.0 / 2.4)) - 0.055;
+  return mix(high, low, lessThanEqual(linear, vec3(0.0031308)));
+}
+
 void main() {
-  outColor = vec4(fragColor, 1.0);
+  vec3 color = fragColor;
+  if (ENCODE_SRGB) {
+    color = encodeSrgb(color);
+  }
+  outColor = vec4(color, 1.0);
 }
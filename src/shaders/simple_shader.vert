@@ -1,11 +1,21 @@
 #version 450
 
+// SNORM16 position in [-1, 1], dequantized with the per-mesh bounds
 layout(location = 0) in vec2 position;
-layout(location = 1) in vec3 color;
+// RGBA8 UNORM color
+layout(location = 1) in vec4 color;
 
 layout(location = 0) out vec3 fragColor;
 
+layout(push_constant) uniform Push {
+  vec2 positionScale;
+  vec2 positionOffset;
+} push;
+
+invariant gl_Position;
+
 void main() {
-  gl_Position = vec4(position, 0.0, 1.0);
-  fragColor = color;
+  gl_Position =
+      vec4(position * push.positionScale + push.positionOffset, 0.0, 1.0);
+  fragColor = color.rgb;
 }
@@ -1,9 +1,10 @@
 #include "swapchain.h"
 
+#include "logger.h"
+
 #include <array>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <limits>
 #include <set>
 #include <stdexcept>
@@ -19,48 +20,57 @@ SwapChain::SwapChain(Device &deviceRef,
                      VkExtent2D extent,
                      std::shared_ptr<SwapChain> prevSwapchain)
     : device{deviceRef}, windowExtent{extent}, prevSwapchain{prevSwapchain} {
+  attachmentPool = prevSwapchain->attachmentPool;
   init();
-  prevSwapchain = nullptr;
+  this->prevSwapchain = nullptr;
 }
 
 void SwapChain::init() {
+  dynamicRendering = device.supportsDynamicRendering();
+
   createSwapChain();
   createImageViews();
-  createRenderPass();
+  if (!dynamicRendering) {
+    createRenderPass();
+  }
   createDepthResources();
-  createFramebuffers();
+  if (!dynamicRendering) {
+    createFramebuffers();
+  }
   createSyncObjects();
 }
 
 SwapChain::~SwapChain() {
-  for (auto imageView : swapChainImageViews) {
-    vkDestroyImageView(device.device(), imageView, nullptr);
-  }
-  swapChainImageViews.clear();
-
-  if (swapChain != nullptr) {
-    vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
-    swapChain = nullptr;
-  }
-
-  for (int i = 0; i < depthImages.size(); i++) {
-    vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-    vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
-  }
-
-  for (auto framebuffer : swapChainFramebuffers) {
-    vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
-  }
-
-  vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  // frames presenting from this swapchain may still be in flight
+  device.getDeletionQueue().push([device = device.device(),
+                                  allocator = device.allocator(),
+                                  swapChain = swapChain,
+                                  imageViews = swapChainImageViews,
+                                  framebuffers = swapChainFramebuffers,
+                                  renderPass = renderPass,
+                                  renderFinished = renderFinishedSemaphores,
+                                  imageAvailable = imageAvailableSemaphores,
+                                  fences = inFlightFences] {
+    for (auto imageView : imageViews) {
+      vkDestroyImageView(device, imageView, allocator);
+    }
+    vkDestroySwapchainKHR(device, swapChain, allocator);
+    for (auto framebuffer : framebuffers) {
+      vkDestroyFramebuffer(device, framebuffer, allocator);
+    }
+    vkDestroyRenderPass(device, renderPass, allocator);
 
-  // cleanup synchronization objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
-    vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device.device(), inFlightFences[i], nullptr);
-  }
+    // cleanup synchronization objects, unless a replacement took them over
+    for (auto semaphore : renderFinished) {
+      vkDestroySemaphore(device, semaphore, allocator);
+    }
+    for (auto semaphore : imageAvailable) {
+      vkDestroySemaphore(device, semaphore, allocator);
+    }
+    for (auto fence : fences) {
+      vkDestroyFence(device, fence, allocator);
+    }
+  });
 }
 
 VkResult SwapChain::acquireNextImage(uint32_t *imageIndex) {
@@ -69,6 +79,7 @@ VkResult SwapChain::acquireNextImage(uint32_t *imageIndex) {
                   &inFlightFences[currentFrame],
                   VK_TRUE,
                   std::numeric_limits<uint64_t>::max());
+  device.getDeletionQueue().collect(submittedFrames[currentFrame]);
 
   VkResult result = vkAcquireNextImageKHR(
       device.device(),
@@ -79,15 +90,17 @@ VkResult SwapChain::acquireNextImage(uint32_t *imageIndex) {
       VK_NULL_HANDLE,
       imageIndex);
 
+  // an earlier frame may still be rendering to this image
+  if ((result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) &&
+      imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+    vkWaitForFences(
+        device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+  }
   return result;
 }
 
 VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
                                          uint32_t *imageIndex) {
-  if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-    vkWaitForFences(
-        device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-  }
   imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
 
   VkSubmitInfo submitInfo = {};
@@ -114,6 +127,7 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer *buffers,
                     inFlightFences[currentFrame]) != VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
   }
+  submittedFrames[currentFrame] = device.getDeletionQueue().endFrame();
 
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -183,8 +197,10 @@ void SwapChain::createSwapChain() {
   createInfo.oldSwapchain =
       prevSwapchain == nullptr ? VK_NULL_HANDLE : prevSwapchain->swapChain;
 
-  if (vkCreateSwapchainKHR(device.device(), &createInfo, nullptr, &swapChain) !=
-      VK_SUCCESS) {
+  if (vkCreateSwapchainKHR(device.device(),
+                           &createInfo,
+                           device.allocator(),
+                           &swapChain) != VK_SUCCESS) {
     throw std::runtime_error("failed to create swap chain!");
   }
 
@@ -216,20 +232,30 @@ void SwapChain::createImageViews() {
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
-    if (vkCreateImageView(
-            device.device(), &viewInfo, nullptr, &swapChainImageViews[i]) !=
-        VK_SUCCESS) {
+    if (vkCreateImageView(device.device(),
+                          &viewInfo,
+                          device.allocator(),
+                          &swapChainImageViews[i]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create texture image view!");
     }
   }
 }
 
 void SwapChain::createRenderPass() {
+  // render passes only depend on the attachment formats
+  if (prevSwapchain != nullptr && prevSwapchain->renderPass != VK_NULL_HANDLE &&
+      prevSwapchain->swapChainImageFormat == swapChainImageFormat) {
+    renderPass = prevSwapchain->renderPass;
+    prevSwapchain->renderPass = VK_NULL_HANDLE;
+    return;
+  }
+
   VkAttachmentDescription depthAttachment{};
   depthAttachment.format = findDepthFormat();
   depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  // kept for the hi-z pyramid build that follows the render pass
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -254,116 +280,141 @@ void SwapChain::createRenderPass() {
   colorAttachmentRef.attachment = 0;
   colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-  VkSubpassDescription subpass = {};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
-  subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-  VkSubpassDependency dependency = {};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.srcAccessMask = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.dstSubpass = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
+  // subpass 0 lays down depth only, subpass 1 shades against it; when the
+  // prepass is disabled subpass 0 is simply left empty
+  VkSubpassDescription depthPrepass = {};
+  depthPrepass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  depthPrepass.colorAttachmentCount = 0;
+  depthPrepass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  VkSubpassDescription colorPass = {};
+  colorPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  colorPass.colorAttachmentCount = 1;
+  colorPass.pColorAttachments = &colorAttachmentRef;
+  colorPass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  std::array<VkSubpassDependency, 3> dependencies = {};
+  // the depth buffer is first used by the prepass, after the last hi-z
+  // build read it
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependencies[0].dstSubpass = DEPTH_PREPASS_SUBPASS;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  dependencies[1].srcSubpass = DEPTH_PREPASS_SUBPASS;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstSubpass = COLOR_SUBPASS;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  // The swapchain image is only used by the color subpass. Its layout
+  // transition has to wait for the image-available semaphore, which is waited
+  // on at the color attachment output stage.
+  dependencies[2].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[2].srcAccessMask = 0;
+  dependencies[2].dstSubpass = COLOR_SUBPASS;
+  dependencies[2].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[2].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  std::array<VkSubpassDescription, 2> subpasses = {depthPrepass, colorPass};
   std::array<VkAttachmentDescription, 2> attachments = {colorAttachment,
                                                         depthAttachment};
   VkRenderPassCreateInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
   renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
   renderPassInfo.pAttachments = attachments.data();
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
 
   if (vkCreateRenderPass(
-          device.device(), &renderPassInfo, nullptr, &renderPass) !=
+          device.device(), &renderPassInfo, device.allocator(), &renderPass) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
   }
 }
 
 void SwapChain::createFramebuffers() {
-  swapChainFramebuffers.resize(imageCount());
-  for (size_t i = 0; i < imageCount(); i++) {
-    std::array<VkImageView, 2> attachments = {swapChainImageViews[i],
-                                              depthImageViews[i]};
-
-    VkExtent2D swapChainExtent = getSwapChainExtent();
-    VkFramebufferCreateInfo framebufferInfo = {};
-    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferInfo.renderPass = renderPass;
-    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    framebufferInfo.pAttachments = attachments.data();
-    framebufferInfo.width = swapChainExtent.width;
-    framebufferInfo.height = swapChainExtent.height;
-    framebufferInfo.layers = 1;
-
-    if (vkCreateFramebuffer(device.device(),
-                            &framebufferInfo,
-                            nullptr,
-                            &swapChainFramebuffers[i]) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create framebuffer!");
+  swapChainFramebuffers.resize(MAX_FRAMES_IN_FLIGHT * imageCount());
+  for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+    for (size_t i = 0; i < imageCount(); i++) {
+      std::array<VkImageView, 2> attachments = {swapChainImageViews[i],
+                                                depthAttachments[frame].view};
+
+      VkExtent2D swapChainExtent = getSwapChainExtent();
+      VkFramebufferCreateInfo framebufferInfo = {};
+      framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+      framebufferInfo.renderPass = renderPass;
+      framebufferInfo.attachmentCount =
+          static_cast<uint32_t>(attachments.size());
+      framebufferInfo.pAttachments = attachments.data();
+      framebufferInfo.width = swapChainExtent.width;
+      framebufferInfo.height = swapChainExtent.height;
+      framebufferInfo.layers = 1;
+
+      if (vkCreateFramebuffer(
+              device.device(),
+              &framebufferInfo,
+              device.allocator(),
+              &swapChainFramebuffers[frame * imageCount() + i]) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+      }
     }
   }
 }
 
 void SwapChain::createDepthResources() {
-  VkFormat depthFormat = findDepthFormat();
-  VkExtent2D swapChainExtent = getSwapChainExtent();
-
-  depthImages.resize(imageCount());
-  depthImageMemorys.resize(imageCount());
-  depthImageViews.resize(imageCount());
-
-  for (int i = 0; i < depthImages.size(); i++) {
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = swapChainExtent.width;
-    imageInfo.extent.height = swapChainExtent.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = depthFormat;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.flags = 0;
-
-    device.createImageWithInfo(imageInfo,
-                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                               depthImages[i],
-                               depthImageMemorys[i]);
-
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = depthImages[i];
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = depthFormat;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
+  if (attachmentPool == nullptr) {
+    attachmentPool = std::make_shared<AttachmentPool>(device);
+  }
 
-    if (vkCreateImageView(
-            device.device(), &viewInfo, nullptr, &depthImageViews[i]) !=
-        VK_SUCCESS) {
-      throw std::runtime_error("failed to create texture image view!");
-    }
+  // sampled by the hi-z pyramid build, so it cannot be transient
+  AttachmentDesc depthDesc{};
+  depthDesc.format = findDepthFormat();
+  depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT;
+  depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+  depthAttachments.resize(MAX_FRAMES_IN_FLIGHT);
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    depthAttachments[i] =
+        attachmentPool->acquire(depthDesc, getSwapChainExtent(), i);
   }
 }
 
 void SwapChain::createSyncObjects() {
+  // Frame slots outlive swapchains: taking over the previous one's fences
+  // keeps waiting on frames it still has in flight, so nothing has to drain
+  // the GPU. The per-image fences carry over while the image count is
+  // unchanged.
+  if (prevSwapchain != nullptr) {
+    imageAvailableSemaphores.swap(prevSwapchain->imageAvailableSemaphores);
+    renderFinishedSemaphores.swap(prevSwapchain->renderFinishedSemaphores);
+    inFlightFences.swap(prevSwapchain->inFlightFences);
+    submittedFrames = prevSwapchain->submittedFrames;
+    currentFrame = prevSwapchain->currentFrame;
+    if (prevSwapchain->imageCount() == imageCount()) {
+      imagesInFlight = prevSwapchain->imagesInFlight;
+    } else {
+      imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+    }
+    return;
+  }
+
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
@@ -379,15 +430,16 @@ void SwapChain::createSyncObjects() {
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     if (vkCreateSemaphore(device.device(),
                           &semaphoreInfo,
-                          nullptr,
+                          device.allocator(),
                           &imageAvailableSemaphores[i]) != VK_SUCCESS ||
         vkCreateSemaphore(device.device(),
                           &semaphoreInfo,
-                          nullptr,
+                          device.allocator(),
                           &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-        vkCreateFence(
-            device.device(), &fenceInfo, nullptr, &inFlightFences[i]) !=
-            VK_SUCCESS) {
+        vkCreateFence(device.device(),
+                      &fenceInfo,
+                      device.allocator(),
+                      &inFlightFences[i]) != VK_SUCCESS) {
       throw std::runtime_error(
           "failed to create synchronization objects for a frame!");
     }
@@ -410,19 +462,19 @@ VkPresentModeKHR SwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
   for (const auto &availablePresentMode : availablePresentModes) {
     if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout << "Present mode: Mailbox" << std::endl;
+      LogMessage{LogSeverity::Info} << "Present mode: Mailbox";
       return availablePresentMode;
     }
   }
 
   // for (const auto &availablePresentMode : availablePresentModes) {
   //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-  //     std::cout << "Present mode: Immediate" << std::endl;
+  //     LogMessage{LogSeverity::Info} << "Present mode: Immediate";
   //     return availablePresentMode;
   //   }
   // }
 
-  std::cout << "Present mode: V-Sync" << std::endl;
+  LogMessage{LogSeverity::Info} << "Present mode: V-Sync";
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -450,7 +502,8 @@ VkFormat SwapChain::findDepthFormat() {
        VK_FORMAT_D32_SFLOAT_S8_UINT,
        VK_FORMAT_D24_UNORM_S8_UINT},
       VK_IMAGE_TILING_OPTIMAL,
-      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
 }  // namespace lve
@@ -1,11 +1,11 @@
 #pragma once
 
+#include "attachment_pool.h"
 #include "device.h"
-
-// vulkan headers
-#include <vulkan/vulkan.h>
+#include "vulkan_loader.h"
 
 // std lib headers
+#include <array>
 #include <memory>
 #include <string>
 #include <vector>
@@ -15,6 +15,8 @@ namespace lve {
 class SwapChain {
  public:
   static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+  static constexpr uint32_t DEPTH_PREPASS_SUBPASS = 0;
+  static constexpr uint32_t COLOR_SUBPASS = 1;
 
   SwapChain(Device &deviceRef, VkExtent2D windowExtent);
   SwapChain(Device &deviceRef,
@@ -25,12 +27,24 @@ class SwapChain {
   SwapChain(const SwapChain &) = delete;
   void operator=(const SwapChain &) = delete;
 
-  VkFramebuffer getFrameBuffer(int index) {
-    return swapChainFramebuffers[index];
+  // framebuffers pair a swapchain image with the frame slot's depth image
+  VkFramebuffer getFrameBuffer(int frameIndex, int imageIndex) {
+    return swapChainFramebuffers[frameIndex * imageCount() + imageIndex];
   }
+  // VK_NULL_HANDLE, and no framebuffers, with dynamic rendering
   VkRenderPass getRenderPass() { return renderPass; }
+  bool usesDynamicRendering() { return dynamicRendering; }
+  VkImage getImage(int index) { return swapChainImages[index]; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+  VkImage getDepthImage(int frameIndex) {
+    return depthAttachments[frameIndex].image;
+  }
+  VkImageView getDepthImageView(int frameIndex) {
+    return depthAttachments[frameIndex].view;
+  }
   size_t imageCount() { return swapChainImages.size(); }
+  // frame slot used by the next acquireNextImage/submitCommandBuffers pair
+  int getCurrentFrameIndex() { return static_cast<int>(currentFrame); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
   uint32_t width() { return swapChainExtent.width; }
@@ -65,12 +79,13 @@ class SwapChain {
   VkFormat swapChainImageFormat;
   VkExtent2D swapChainExtent;
 
+  bool dynamicRendering;
   std::vector<VkFramebuffer> swapChainFramebuffers;
-  VkRenderPass renderPass;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
 
-  std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
-  std::vector<VkImageView> depthImageViews;
+  // shared with the swapchains that replace this one
+  std::shared_ptr<AttachmentPool> attachmentPool;
+  std::vector<PooledAttachment> depthAttachments;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
 
@@ -84,6 +99,8 @@ class SwapChain {
   std::vector<VkSemaphore> renderFinishedSemaphores;
   std::vector<VkFence> inFlightFences;
   std::vector<VkFence> imagesInFlight;
+  // deletion queue frame last submitted with each in-flight fence, 0 if none
+  std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> submittedFrames{};
   size_t currentFrame = 0;
 };
 
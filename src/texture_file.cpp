@@ -0,0 +1,219 @@
+#include "texture_file.h"
+
+// std lib headers
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// posix headers
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lve {
+
+static constexpr uint32_t makeFourCC(char a, char b, char c, char d) {
+  return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+         (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+constexpr uint32_t DDS_MAGIC = makeFourCC('D', 'D', 'S', ' ');
+constexpr uint32_t DDS_FOURCC_FLAG = 0x4;
+constexpr uint32_t DDS_CUBEMAP_FLAG = 0x200;
+constexpr uint32_t DDS_VOLUME_FLAG = 0x200000;
+constexpr uint32_t DX10_TEXTURE2D_DIMENSION = 3;
+constexpr uint32_t DX10_TEXTURECUBE_FLAG = 0x4;
+
+struct DdsPixelFormat {
+  uint32_t size;
+  uint32_t flags;
+  uint32_t fourCC;
+  uint32_t rgbBitCount;
+  uint32_t masks[4];
+};
+
+struct DdsHeader {
+  uint32_t size;
+  uint32_t flags;
+  uint32_t height;
+  uint32_t width;
+  uint32_t pitchOrLinearSize;
+  uint32_t depth;
+  uint32_t mipMapCount;
+  uint32_t reserved1[11];
+  DdsPixelFormat pixelFormat;
+  uint32_t caps[4];
+  uint32_t reserved2;
+};
+
+struct DdsHeaderDx10 {
+  uint32_t dxgiFormat;
+  uint32_t resourceDimension;
+  uint32_t miscFlag;
+  uint32_t arraySize;
+  uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DdsHeader) == 124, "unexpected DDS header size");
+static_assert(sizeof(DdsHeaderDx10) == 20, "unexpected DX10 header size");
+
+static VkFormat formatFromDxgi(uint32_t dxgiFormat) {
+  switch (dxgiFormat) {
+    case 71:
+      return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case 72:
+      return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case 74:
+      return VK_FORMAT_BC2_UNORM_BLOCK;
+    case 75:
+      return VK_FORMAT_BC2_SRGB_BLOCK;
+    case 77:
+      return VK_FORMAT_BC3_UNORM_BLOCK;
+    case 78:
+      return VK_FORMAT_BC3_SRGB_BLOCK;
+    case 80:
+      return VK_FORMAT_BC4_UNORM_BLOCK;
+    case 81:
+      return VK_FORMAT_BC4_SNORM_BLOCK;
+    case 83:
+      return VK_FORMAT_BC5_UNORM_BLOCK;
+    case 84:
+      return VK_FORMAT_BC5_SNORM_BLOCK;
+    case 95:
+      return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+    case 96:
+      return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+    case 98:
+      return VK_FORMAT_BC7_UNORM_BLOCK;
+    case 99:
+      return VK_FORMAT_BC7_SRGB_BLOCK;
+    default:
+      return VK_FORMAT_UNDEFINED;
+  }
+}
+
+static VkFormat formatFromFourCC(uint32_t fourCC) {
+  switch (fourCC) {
+    case makeFourCC('D', 'X', 'T', '1'):
+      return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case makeFourCC('D', 'X', 'T', '3'):
+      return VK_FORMAT_BC2_UNORM_BLOCK;
+    case makeFourCC('D', 'X', 'T', '5'):
+      return VK_FORMAT_BC3_UNORM_BLOCK;
+    case makeFourCC('A', 'T', 'I', '1'):
+    case makeFourCC('B', 'C', '4', 'U'):
+      return VK_FORMAT_BC4_UNORM_BLOCK;
+    case makeFourCC('B', 'C', '4', 'S'):
+      return VK_FORMAT_BC4_SNORM_BLOCK;
+    case makeFourCC('A', 'T', 'I', '2'):
+    case makeFourCC('B', 'C', '5', 'U'):
+      return VK_FORMAT_BC5_UNORM_BLOCK;
+    case makeFourCC('B', 'C', '5', 'S'):
+      return VK_FORMAT_BC5_SNORM_BLOCK;
+    default:
+      return VK_FORMAT_UNDEFINED;
+  }
+}
+
+// bytes per 4x4 block
+static VkDeviceSize blockSize(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+      return 8;
+    default:
+      return 16;
+  }
+}
+
+TextureFile::TextureFile(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    throw std::runtime_error("failed to read texture file: " + path);
+  }
+  mappingSize = static_cast<size_t>(fileStat.st_size);
+
+  mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file referenced
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw std::runtime_error("failed to map texture file: " + path);
+  }
+
+  try {
+    parse(path);
+  } catch (...) {
+    munmap(mapping, mappingSize);
+    throw;
+  }
+}
+
+TextureFile::~TextureFile() { munmap(mapping, mappingSize); }
+
+void TextureFile::parse(const std::string &path) {
+  const auto *bytes = static_cast<const char *>(mapping);
+  size_t offset = sizeof(uint32_t) + sizeof(DdsHeader);
+
+  uint32_t magic;
+  DdsHeader header;
+  if (mappingSize < offset) {
+    throw std::runtime_error("texture file is truncated: " + path);
+  }
+  std::memcpy(&magic, bytes, sizeof(magic));
+  std::memcpy(&header, bytes + sizeof(magic), sizeof(header));
+  if (magic != DDS_MAGIC || header.size != sizeof(DdsHeader)) {
+    throw std::runtime_error("not a DDS file: " + path);
+  }
+  if (header.width == 0 || header.height == 0 ||
+      (header.caps[1] & (DDS_CUBEMAP_FLAG | DDS_VOLUME_FLAG))) {
+    throw std::runtime_error("only 2D textures are supported: " + path);
+  }
+
+  if ((header.pixelFormat.flags & DDS_FOURCC_FLAG) &&
+      header.pixelFormat.fourCC == makeFourCC('D', 'X', '1', '0')) {
+    DdsHeaderDx10 dx10Header;
+    if (mappingSize < offset + sizeof(dx10Header)) {
+      throw std::runtime_error("texture file is truncated: " + path);
+    }
+    std::memcpy(&dx10Header, bytes + offset, sizeof(dx10Header));
+    offset += sizeof(dx10Header);
+    if (dx10Header.resourceDimension != DX10_TEXTURE2D_DIMENSION ||
+        dx10Header.arraySize > 1 ||
+        (dx10Header.miscFlag & DX10_TEXTURECUBE_FLAG)) {
+      throw std::runtime_error("only 2D textures are supported: " + path);
+    }
+    format = formatFromDxgi(dx10Header.dxgiFormat);
+  } else if (header.pixelFormat.flags & DDS_FOURCC_FLAG) {
+    format = formatFromFourCC(header.pixelFormat.fourCC);
+  }
+  if (format == VK_FORMAT_UNDEFINED) {
+    throw std::runtime_error("texture is not block-compressed: " + path);
+  }
+
+  uint32_t mipCount = std::max(header.mipMapCount, 1u);
+  VkExtent2D extent{header.width, header.height};
+  for (uint32_t mip = 0; mip < mipCount; mip++) {
+    VkDeviceSize size = blockSize(format) *
+                        std::max((extent.width + 3) / 4, 1u) *
+                        std::max((extent.height + 3) / 4, 1u);
+    if (mappingSize < offset + size) {
+      throw std::runtime_error("texture file is truncated: " + path);
+    }
+    levels.push_back({bytes + offset, size, extent});
+    offset += size;
+    extent.width = std::max(extent.width / 2, 1u);
+    extent.height = std::max(extent.height / 2, 1u);
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "device.h"
+
+// std lib headers
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// A block-compressed 2D texture in a DDS container, mapped into memory so
+// mip levels can be uploaded straight from the file without reading it.
+// Supports BC1-BC7 through the DX10 header and the legacy DXT1/3/5, ATI1/2
+// and BC4/BC5 four-character codes; every level of the chain must be present.
+class TextureFile {
+ public:
+  struct Level {
+    const void *data;
+    VkDeviceSize size;
+    VkExtent2D extent;
+  };
+
+  TextureFile(const std::string &path);
+  ~TextureFile();
+
+  TextureFile(const TextureFile &) = delete;
+  TextureFile &operator=(const TextureFile &) = delete;
+
+  VkFormat getFormat() const { return format; }
+  VkExtent2D getExtent() const { return levels[0].extent; }
+  uint32_t getMipCount() const { return static_cast<uint32_t>(levels.size()); }
+  const Level &getLevel(uint32_t mip) const { return levels[mip]; }
+
+ private:
+  void parse(const std::string &path);
+
+  void *mapping = nullptr;
+  size_t mappingSize = 0;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  std::vector<Level> levels;
+};
+
+}  // namespace lve
@@ -0,0 +1,491 @@
+#include "texture_streamer.h"
+
+// std lib headers
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+// buffer offsets of block-compressed copies must be multiples of the block
+// size, which is at most 16 bytes for BC formats
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+static VkDeviceSize alignStaging(VkDeviceSize size) {
+  return (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+}
+
+TextureStreamer::TextureStreamer(Device &device, VkDeviceSize budget)
+    : device{device}, configuredBudget{budget} {
+  createUploadBatches();
+}
+
+TextureStreamer::~TextureStreamer() {
+  for (auto &batch : batches) {
+    vkWaitForFences(device.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    for (auto &upload : batch.uploads) {
+      destroyResidency(upload.residency);
+    }
+    vkDestroyFence(device.device(), batch.fence, device.allocator());
+    vkFreeCommandBuffers(
+        device.device(), device.getCommandPool(), 1, &batch.commandBuffer);
+    vkUnmapMemory(device.device(), batch.stagingMemory);
+    vkDestroyBuffer(device.device(), batch.stagingBuffer, device.allocator());
+    vkFreeMemory(device.device(), batch.stagingMemory, device.allocator());
+  }
+  for (auto &texture : textures) {
+    destroyResidency(texture.residency);
+  }
+}
+
+void TextureStreamer::createUploadBatches() {
+  VkCommandBufferAllocateInfo allocateInfo{};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocateInfo.commandPool = device.getCommandPool();
+  allocateInfo.commandBufferCount = 1;
+
+  // signaled so that waiting on a batch that was never submitted returns
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  for (auto &batch : batches) {
+    if (vkAllocateCommandBuffers(device.device(),
+                                 &allocateInfo,
+                                 &batch.commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error(
+          "failed to allocate texture upload command buffer!");
+    }
+    if (vkCreateFence(device.device(),
+                      &fenceInfo,
+                      device.allocator(),
+                      &batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create texture upload fence!");
+    }
+
+    device.createBuffer(STAGING_BATCH_SIZE,
+                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        batch.stagingBuffer,
+                        batch.stagingMemory);
+    void *data;
+    vkMapMemory(device.device(),
+                batch.stagingMemory,
+                0,
+                STAGING_BATCH_SIZE,
+                0,
+                &data);
+    batch.stagingData = static_cast<char *>(data);
+  }
+}
+
+TextureId TextureStreamer::load(const std::string &path) {
+  Texture texture{};
+  texture.file = std::make_unique<TextureFile>(path);
+  device.findSupportedFormat({texture.file->getFormat()},
+                             VK_IMAGE_TILING_OPTIMAL,
+                             VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+  uint32_t mipCount = texture.file->getMipCount();
+  texture.tailMip = mipCount - 1;
+  for (uint32_t mip = 0; mip < mipCount; mip++) {
+    VkExtent2D extent = texture.file->getLevel(mip).extent;
+    if (std::max(extent.width, extent.height) <= MIP_TAIL_SIZE) {
+      texture.tailMip = mip;
+      break;
+    }
+  }
+  if (getLevelsSize(texture, texture.tailMip) > STAGING_BATCH_SIZE) {
+    throw std::runtime_error("texture mip tail exceeds the staging size: " +
+                             path);
+  }
+  texture.minMip = texture.tailMip;
+  while (texture.minMip > 0 &&
+         getLevelsSize(texture, texture.minMip - 1) <= STAGING_BATCH_SIZE) {
+    texture.minMip--;
+  }
+
+  texture.residentMip = mipCount;
+  texture.targetMip = mipCount;
+  texture.wantedMip = texture.tailMip;
+  texture.lastUsedFrame = frame;
+  textures.push_back(std::move(texture));
+  return static_cast<TextureId>(textures.size() - 1);
+}
+
+void TextureStreamer::reportUsage(TextureId id, float screenSize) {
+  auto &texture = textures[id];
+  VkExtent2D extent = texture.file->getExtent();
+  float size = static_cast<float>(std::max(extent.width, extent.height));
+
+  // the coarsest level that still has a texel per covered pixel
+  uint32_t mip = texture.tailMip;
+  if (screenSize >= size) {
+    mip = 0;
+  } else if (screenSize > 0.0f) {
+    mip = std::min(static_cast<uint32_t>(std::log2(size / screenSize)),
+                   texture.tailMip);
+  }
+
+  if (texture.lastUsedFrame != frame) {
+    texture.wantedMip = mip;
+    texture.lastUsedFrame = frame;
+  } else {
+    texture.wantedMip = std::min(texture.wantedMip, mip);
+  }
+}
+
+void TextureStreamer::update() {
+  frame++;
+  completeUploads();
+  scheduleUploads();
+
+  statistics.textureCount = static_cast<uint32_t>(textures.size());
+  statistics.uploadsInFlight = 0;
+  for (const auto &batch : batches) {
+    statistics.uploadsInFlight += static_cast<uint32_t>(batch.uploads.size());
+  }
+}
+
+void TextureStreamer::completeUploads() {
+  for (auto &batch : batches) {
+    if (batch.uploads.empty() ||
+        vkGetFenceStatus(device.device(), batch.fence) != VK_SUCCESS) {
+      continue;
+    }
+
+    for (auto &upload : batch.uploads) {
+      auto &texture = textures[upload.texture];
+      // frames in flight may still sample the previous levels, so they go
+      // through the deletion queue
+      destroyResidency(texture.residency);
+      if (texture.targetMip > texture.residentMip) {
+        statistics.evictedLevels += texture.targetMip - texture.residentMip;
+      }
+      texture.residency = upload.residency;
+      texture.residentMip = texture.targetMip;
+    }
+    batch.uploads.clear();
+  }
+}
+
+void TextureStreamer::scheduleUploads() {
+  auto batch =
+      std::find_if(batches.begin(), batches.end(), [](const UploadBatch &b) {
+        return b.uploads.empty();
+      });
+  if (batch == batches.end()) {
+    return;
+  }
+
+  std::vector<TextureId> loads;
+  std::vector<TextureId> shrinks;
+  std::vector<TextureId> grows;
+  for (TextureId id = 0; id < textures.size(); id++) {
+    const auto &texture = textures[id];
+    if (texture.targetMip != texture.residentMip) {
+      continue;
+    }
+    uint32_t desiredMip = getDesiredMip(texture);
+    if (texture.residentMip == texture.file->getMipCount()) {
+      loads.push_back(id);
+    } else if (desiredMip > texture.residentMip) {
+      shrinks.push_back(id);
+    } else if (desiredMip < texture.residentMip) {
+      grows.push_back(id);
+    }
+  }
+  // most recently used first, then the ones furthest from their desired level
+  std::sort(grows.begin(), grows.end(), [&](TextureId a, TextureId b) {
+    const auto &textureA = textures[a];
+    const auto &textureB = textures[b];
+    if (textureA.lastUsedFrame != textureB.lastUsedFrame) {
+      return textureA.lastUsedFrame > textureB.lastUsedFrame;
+    }
+    return textureA.residentMip - getDesiredMip(textureA) >
+           textureB.residentMip - getDesiredMip(textureB);
+  });
+  if (loads.empty() && shrinks.empty() && grows.empty()) {
+    return;
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(batch->commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error(
+        "failed to begin recording texture upload command buffer!");
+  }
+  batch->stagingUsed = 0;
+
+  VkDeviceSize budget = getBudget();
+  VkDeviceSize committed = getCommittedBytes();
+  auto resize = [&](TextureId id, uint32_t baseMip) {
+    auto &texture = textures[id];
+    VkDeviceSize before = getLevelsSize(texture, texture.residentMip);
+    if (!recordUpload(*batch, id, baseMip)) {
+      return false;
+    }
+    committed = committed - before + getLevelsSize(texture, baseMip);
+    return true;
+  };
+
+  // mip tails are always loaded, and shrinking frees memory
+  bool stagingFull = false;
+  for (TextureId id : loads) {
+    if (!resize(id, textures[id].tailMip)) {
+      stagingFull = true;
+      break;
+    }
+  }
+  for (size_t i = 0; i < shrinks.size() && !stagingFull; i++) {
+    stagingFull = !resize(shrinks[i], getDesiredMip(textures[shrinks[i]]));
+  }
+
+  // one finer level at a time, dropping the finest level of less recently
+  // used textures while over budget
+  for (size_t i = 0; i < grows.size() && !stagingFull; i++) {
+    const auto &texture = textures[grows[i]];
+    if (texture.targetMip != texture.residentMip) {
+      continue;
+    }
+    uint32_t baseMip = texture.residentMip - 1;
+    VkDeviceSize growth = getLevelsSize(texture, baseMip) -
+                          getLevelsSize(texture, texture.residentMip);
+
+    while (committed + growth > budget && !stagingFull) {
+      TextureId victim = findEvictionVictim(texture.lastUsedFrame);
+      if (victim == textures.size()) {
+        break;
+      }
+      stagingFull = !resize(victim, textures[victim].residentMip + 1);
+    }
+    if (stagingFull || committed + growth > budget) {
+      break;
+    }
+    stagingFull = !resize(grows[i], baseMip);
+  }
+
+  if (vkEndCommandBuffer(batch->commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record texture upload command buffer!");
+  }
+  if (!batch->uploads.empty()) {
+    submit(*batch);
+  }
+}
+
+TextureId TextureStreamer::findEvictionVictim(uint64_t usedBefore) const {
+  TextureId victim = static_cast<TextureId>(textures.size());
+  for (TextureId id = 0; id < textures.size(); id++) {
+    const auto &texture = textures[id];
+    if (texture.targetMip != texture.residentMip ||
+        texture.residentMip >= texture.tailMip ||
+        texture.lastUsedFrame >= usedBefore) {
+      continue;
+    }
+    if (victim == textures.size() ||
+        texture.lastUsedFrame < textures[victim].lastUsedFrame) {
+      victim = id;
+    }
+  }
+  return victim;
+}
+
+bool TextureStreamer::recordUpload(UploadBatch &batch,
+                                   TextureId id,
+                                   uint32_t baseMip) {
+  auto &texture = textures[id];
+  const auto &file = *texture.file;
+  if (batch.stagingUsed + getLevelsSize(texture, baseMip) >
+      STAGING_BATCH_SIZE) {
+    return false;
+  }
+
+  Residency residency = createResidency(texture, baseMip);
+  uint32_t levelCount = file.getMipCount() - baseMip;
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = residency.image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+  vkCmdPipelineBarrier(batch.commandBuffer,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+
+  std::vector<VkBufferImageCopy> regions;
+  for (uint32_t mip = file.getMipCount(); mip-- > baseMip;) {
+    const auto &level = file.getLevel(mip);
+    std::memcpy(batch.stagingData + batch.stagingUsed, level.data, level.size);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = batch.stagingUsed;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - baseMip, 0, 1};
+    region.imageExtent = {level.extent.width, level.extent.height, 1};
+    regions.push_back(region);
+
+    batch.stagingUsed += alignStaging(level.size);
+    statistics.uploadedBytes += level.size;
+  }
+  vkCmdCopyBufferToImage(batch.commandBuffer,
+                         batch.stagingBuffer,
+                         residency.image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(batch.commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+
+  texture.targetMip = baseMip;
+  batch.uploads.push_back({id, residency});
+  return true;
+}
+
+void TextureStreamer::submit(UploadBatch &batch) {
+  vkResetFences(device.device(), 1, &batch.fence);
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, batch.fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit texture uploads!");
+  }
+}
+
+VkDeviceSize TextureStreamer::getBudget() {
+  VkDeviceSize budget = configuredBudget;
+  if (device.supportsMemoryBudget()) {
+    // the heap usage includes our own textures, which the budget is for
+    MemoryBudget heap = device.getDeviceLocalMemoryBudget();
+    VkDeviceSize otherUsage = heap.usage > statistics.residentBytes
+                                  ? heap.usage - statistics.residentBytes
+                                  : 0;
+    VkDeviceSize available =
+        heap.budget > otherUsage ? heap.budget - otherUsage : 0;
+    budget = std::min(budget, available);
+  }
+  statistics.budgetBytes = budget;
+  return budget;
+}
+
+VkDeviceSize TextureStreamer::getCommittedBytes() const {
+  VkDeviceSize committed = 0;
+  for (const auto &texture : textures) {
+    committed += getLevelsSize(texture, texture.targetMip);
+  }
+  return committed;
+}
+
+VkDeviceSize TextureStreamer::getLevelsSize(const Texture &texture,
+                                            uint32_t baseMip) const {
+  VkDeviceSize size = 0;
+  for (uint32_t mip = baseMip; mip < texture.file->getMipCount(); mip++) {
+    size += alignStaging(texture.file->getLevel(mip).size);
+  }
+  return size;
+}
+
+uint32_t TextureStreamer::getDesiredMip(const Texture &texture) const {
+  if (frame - texture.lastUsedFrame > EVICT_AFTER_FRAMES) {
+    return texture.tailMip;
+  }
+  return std::max(texture.wantedMip, texture.minMip);
+}
+
+TextureStreamer::Residency TextureStreamer::createResidency(
+    const Texture &texture, uint32_t baseMip) {
+  const auto &file = *texture.file;
+  VkExtent2D extent = file.getLevel(baseMip).extent;
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {extent.width, extent.height, 1};
+  imageInfo.mipLevels = file.getMipCount() - baseMip;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = file.getFormat();
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage =
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  Residency residency;
+  device.createImageWithInfo(imageInfo,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             residency.image,
+                             residency.memory);
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(
+      device.device(), residency.image, &memRequirements);
+  residency.size = memRequirements.size;
+  statistics.residentBytes += residency.size;
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = residency.image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = imageInfo.format;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = imageInfo.mipLevels;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+  if (vkCreateImageView(
+          device.device(), &viewInfo, device.allocator(), &residency.view) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture image view!");
+  }
+  return residency;
+}
+
+void TextureStreamer::destroyResidency(Residency &residency) {
+  if (residency.image == VK_NULL_HANDLE) {
+    return;
+  }
+  device.getDeletionQueue().push([device = device.device(),
+                                  allocator = device.allocator(),
+                                  view = residency.view,
+                                  image = residency.image,
+                                  memory = residency.memory] {
+    vkDestroyImageView(device, view, allocator);
+    vkDestroyImage(device, image, allocator);
+    vkFreeMemory(device, memory, allocator);
+  });
+  statistics.residentBytes -= residency.size;
+  residency = Residency{};
+}
+
+}  // namespace lve
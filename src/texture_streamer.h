@@ -0,0 +1,142 @@
+#pragma once
+
+#include "device.h"
+#include "texture_file.h"
+
+// std lib headers
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+using TextureId = uint32_t;
+
+// Keeps a bounded set of mip levels of block-compressed textures resident.
+//
+// Loading a texture maps its file and uploads only its mip tail, the levels
+// no larger than MIP_TAIL_SIZE, which stays resident for the texture's
+// lifetime. Renderers report how large a texture appears on screen every
+// frame; update() then streams in one finer level at a time for textures
+// sampled above their resident resolution, and drops levels of textures that
+// shrank on screen or have not been reported for EVICT_AFTER_FRAMES frames.
+// The budget is the smaller of the configured one and what
+// VK_EXT_memory_budget says is left on the device-local heaps; when it is
+// exhausted, the least recently used textures give up their finest levels.
+//
+// A residency change creates an image with the new level range, uploads the
+// levels coarsest first from the mapped file through a staging buffer and
+// swaps the image in once the upload's fence has signaled. Nothing waits on
+// the GPU, and the previous image stays alive until the frames in flight that
+// may sample it are done, so both briefly count against the budget.
+class TextureStreamer {
+ public:
+  static constexpr uint32_t MIP_TAIL_SIZE = 128;
+  static constexpr uint32_t EVICT_AFTER_FRAMES = 120;
+  static constexpr uint32_t UPLOAD_BATCH_COUNT = 2;
+  // also bounds the finest level a texture can stream in, since a residency
+  // change uploads all of its levels in one batch
+  static constexpr VkDeviceSize STAGING_BATCH_SIZE = 32 * 1024 * 1024;
+
+  struct Statistics {
+    uint32_t textureCount = 0;
+    uint32_t uploadsInFlight = 0;
+    VkDeviceSize residentBytes = 0;
+    VkDeviceSize budgetBytes = 0;
+    VkDeviceSize uploadedBytes = 0;
+    uint32_t evictedLevels = 0;
+  };
+
+  TextureStreamer(Device &device, VkDeviceSize budget);
+  ~TextureStreamer();
+
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+  TextureId load(const std::string &path);
+
+  // Usage feedback: the longest side, in pixels, the texture covers on screen
+  // in the frame being recorded.
+  void reportUsage(TextureId texture, float screenSize);
+
+  // Call once per frame after the frame slot's fence has been waited on.
+  void update();
+
+  // VK_NULL_HANDLE until the mip tail is resident. The view changes with the
+  // resident levels, so look it up every frame.
+  VkImageView getImageView(TextureId texture) const {
+    return textures[texture].residency.view;
+  }
+  // finest resident level of the file's mip chain
+  uint32_t getResidentMip(TextureId texture) const {
+    return textures[texture].residentMip;
+  }
+  const Statistics &getStatistics() const { return statistics; }
+
+ private:
+  struct Residency {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+  };
+
+  struct Texture {
+    std::unique_ptr<TextureFile> file;
+    Residency residency;
+    // the mip count when nothing is resident yet
+    uint32_t residentMip;
+    // differs from residentMip while an upload is in flight
+    uint32_t targetMip;
+    // the finest level whose upload fits a staging batch
+    uint32_t minMip;
+    uint32_t tailMip;
+    uint32_t wantedMip;
+    uint64_t lastUsedFrame = 0;
+  };
+
+  struct Upload {
+    TextureId texture;
+    Residency residency;
+  };
+
+  struct UploadBatch {
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    char *stagingData;
+    VkDeviceSize stagingUsed = 0;
+    // empty once the batch's uploads have been swapped in
+    std::vector<Upload> uploads;
+  };
+
+  void createUploadBatches();
+  void completeUploads();
+  void scheduleUploads();
+  // false when the levels do not fit the batch's remaining staging memory
+  bool recordUpload(UploadBatch &batch, TextureId texture, uint32_t baseMip);
+  void submit(UploadBatch &batch);
+  // the least recently used texture above its mip tail that was last used
+  // before the given frame, or textures.size()
+  TextureId findEvictionVictim(uint64_t usedBefore) const;
+
+  VkDeviceSize getBudget();
+  VkDeviceSize getCommittedBytes() const;
+  VkDeviceSize getLevelsSize(const Texture &texture, uint32_t baseMip) const;
+  uint32_t getDesiredMip(const Texture &texture) const;
+
+  Residency createResidency(const Texture &texture, uint32_t baseMip);
+  void destroyResidency(Residency &residency);
+
+  Device &device;
+  VkDeviceSize configuredBudget;
+  std::vector<Texture> textures;
+  std::array<UploadBatch, UPLOAD_BATCH_COUNT> batches;
+  uint64_t frame = 0;
+  Statistics statistics;
+};
+
+}  // namespace lve
@@ -0,0 +1,57 @@
+#pragma once
+
+// std lib headers
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace lve {
+
+// Hands the latest value from one writer thread to one reader thread without
+// locks, and without either side ever waiting for the other.
+//
+// The writer fills one buffer while the reader holds another. Publishing
+// swaps the filled buffer with the third, which so always holds the newest
+// published value; the reader swaps it for its own when it looks for a newer
+// one. Values published faster than the reader takes them are dropped. The
+// write buffer is not cleared between publishes, so assign all of it.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // writer side
+  T &getWriteBuffer() { return buffers[writeIndex]; }
+  void publish() {
+    uint8_t previous =
+        shared.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+    writeIndex = previous & INDEX_MASK;
+  }
+
+  // Reader side; returns whether a value newer than the read buffer's was
+  // published, which then becomes the read buffer.
+  bool update() {
+    if ((shared.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+      return false;
+    }
+    uint8_t previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+    readIndex = previous & INDEX_MASK;
+    return true;
+  }
+  const T &getReadBuffer() const { return buffers[readIndex]; }
+
+ private:
+  static constexpr uint8_t INDEX_MASK = 0x3;
+  // set while the shared buffer holds a value the reader has not taken
+  static constexpr uint8_t FRESH_BIT = 0x4;
+
+  std::array<T, 3> buffers{};
+  uint8_t writeIndex = 0;
+  uint8_t readIndex = 1;
+  std::atomic<uint8_t> shared{2};
+};
+
+}  // namespace lve
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "vulkan_loader.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std lib headers
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace lve {
+
+// Normalized integer storage types. Vertex members use these instead of raw
+// integer arrays so the attribute format (SNORM/UNORM vs SINT/UINT) is part of
+// the member type and can be derived at compile time.
+struct Snorm16x2 {
+  int16_t x;
+  int16_t y;
+};
+
+struct Unorm8x4 {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t a;
+};
+
+template <typename T>
+struct VertexFormat;
+
+template <>
+struct VertexFormat<float> {
+  static constexpr VkFormat value = VK_FORMAT_R32_SFLOAT;
+};
+
+template <>
+struct VertexFormat<glm::vec2> {
+  static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT;
+};
+
+template <>
+struct VertexFormat<glm::vec3> {
+  static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+template <>
+struct VertexFormat<glm::vec4> {
+  static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT;
+};
+
+template <>
+struct VertexFormat<Snorm16x2> {
+  static constexpr VkFormat value = VK_FORMAT_R16G16_SNORM;
+};
+
+template <>
+struct VertexFormat<Unorm8x4> {
+  static constexpr VkFormat value = VK_FORMAT_R8G8B8A8_UNORM;
+};
+
+template <typename T, uint32_t Offset>
+struct VertexAttribute {
+  static constexpr VkFormat format = VertexFormat<T>::value;
+  static constexpr uint32_t offset = Offset;
+};
+
+// Declares an attribute from a vertex struct member, e.g.
+// LVE_VERTEX_ATTRIBUTE(PositionVertex, position).
+#define LVE_VERTEX_ATTRIBUTE(Vertex, member) \
+  ::lve::VertexAttribute<decltype(Vertex::member), offsetof(Vertex, member)>
+
+// One vertex buffer binding: the struct stored in the buffer and the
+// attributes read from it, in shader location order.
+template <typename Vertex, typename... Attributes>
+struct VertexStream {
+  static constexpr uint32_t stride = sizeof(Vertex);
+  static constexpr uint32_t attributeCount = sizeof...(Attributes);
+  static constexpr std::array<VkFormat, attributeCount> formats{
+      Attributes::format...};
+  static constexpr std::array<uint32_t, attributeCount> offsets{
+      Attributes::offset...};
+};
+
+namespace detail {
+
+template <typename... Streams>
+constexpr std::array<VkVertexInputBindingDescription, sizeof...(Streams)>
+makeBindingDescriptions() {
+  std::array<VkVertexInputBindingDescription, sizeof...(Streams)> bindings{};
+  uint32_t strides[] = {Streams::stride...};
+  for (uint32_t i = 0; i < sizeof...(Streams); i++) {
+    bindings[i].binding = i;
+    bindings[i].stride = strides[i];
+    bindings[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  }
+  return bindings;
+}
+
+template <typename Stream, size_t N>
+constexpr void appendAttributeDescriptions(
+    std::array<VkVertexInputAttributeDescription, N>& attributes,
+    uint32_t binding,
+    uint32_t& location) {
+  for (uint32_t i = 0; i < Stream::attributeCount; i++) {
+    attributes[location].location = location;
+    attributes[location].binding = binding;
+    attributes[location].format = Stream::formats[i];
+    attributes[location].offset = Stream::offsets[i];
+    location++;
+  }
+}
+
+template <size_t N, typename... Streams, size_t... Bindings>
+constexpr std::array<VkVertexInputAttributeDescription, N>
+makeAttributeDescriptions(std::index_sequence<Bindings...>) {
+  std::array<VkVertexInputAttributeDescription, N> attributes{};
+  uint32_t location = 0;
+  (appendAttributeDescriptions<Streams>(attributes, Bindings, location), ...);
+  return attributes;
+}
+
+}  // namespace detail
+
+// Vertex input state derived at compile time from a list of streams. Stream i
+// is bound at binding i and attribute locations are assigned consecutively
+// across the streams, so a layout holding only the first stream (e.g.
+// positions for a depth pass) keeps the same locations as the full one.
+template <typename... Streams>
+struct VertexLayout {
+  static_assert(sizeof...(Streams) > 0, "a vertex layout needs a stream");
+
+  static constexpr uint32_t bindingCount = sizeof...(Streams);
+  static constexpr uint32_t attributeCount =
+      (Streams::attributeCount + ... + 0);
+
+  static constexpr std::array<VkVertexInputBindingDescription, bindingCount>
+      bindingDescriptions = detail::makeBindingDescriptions<Streams...>();
+  static constexpr std::array<VkVertexInputAttributeDescription,
+                              attributeCount>
+      attributeDescriptions =
+          detail::makeAttributeDescriptions<attributeCount, Streams...>(
+              std::make_index_sequence<bindingCount>{});
+
+  static VkPipelineVertexInputStateCreateInfo getInputStateInfo() {
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = bindingCount;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = attributeCount;
+    vertexInputInfo.pVertexAttributeDescriptions =
+        attributeDescriptions.data();
+    return vertexInputInfo;
+  }
+};
+
+}  // namespace lve
@@ -0,0 +1,75 @@
+#include "vulkan_loader.h"
+
+// std lib headers
+#include <stdexcept>
+#include <string>
+
+// posix headers
+#include <dlfcn.h>
+
+#define LVE_VULKAN_DEFINE_COMMAND(name) PFN_##name name = nullptr;
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
+LVE_VULKAN_GLOBAL_COMMANDS(LVE_VULKAN_DEFINE_COMMAND)
+LVE_VULKAN_INSTANCE_COMMANDS(LVE_VULKAN_DEFINE_COMMAND)
+LVE_VULKAN_DEVICE_COMMANDS(LVE_VULKAN_DEFINE_COMMAND)
+#undef LVE_VULKAN_DEFINE_COMMAND
+
+namespace lve {
+
+static void *library = nullptr;
+
+void loadVulkanLibrary() {
+  if (library != nullptr) {
+    return;
+  }
+  for (const char *name : {"libvulkan.so.1", "libvulkan.so"}) {
+    library = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+    if (library != nullptr) {
+      break;
+    }
+  }
+  if (library == nullptr) {
+    throw std::runtime_error("failed to load the Vulkan library!");
+  }
+
+  vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
+      dlsym(library, "vkGetInstanceProcAddr"));
+  if (vkGetInstanceProcAddr == nullptr) {
+    throw std::runtime_error("failed to find vkGetInstanceProcAddr!");
+  }
+
+#define LVE_VULKAN_LOAD_COMMAND(name) \
+  name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(nullptr, #name));
+  LVE_VULKAN_GLOBAL_COMMANDS(LVE_VULKAN_LOAD_COMMAND)
+#undef LVE_VULKAN_LOAD_COMMAND
+}
+
+void loadInstanceCommands(VkInstance instance) {
+#define LVE_VULKAN_LOAD_COMMAND(name) \
+  name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+  LVE_VULKAN_INSTANCE_COMMANDS(LVE_VULKAN_LOAD_COMMAND)
+#undef LVE_VULKAN_LOAD_COMMAND
+}
+
+void loadDeviceCommands(VkDevice device) {
+#define LVE_VULKAN_LOAD_COMMAND(name) \
+  name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+  LVE_VULKAN_DEVICE_COMMANDS(LVE_VULKAN_LOAD_COMMAND)
+#undef LVE_VULKAN_LOAD_COMMAND
+}
+
+void unloadVulkanLibrary() {
+  if (library == nullptr) {
+    return;
+  }
+#define LVE_VULKAN_RESET_COMMAND(name) name = nullptr;
+  LVE_VULKAN_GLOBAL_COMMANDS(LVE_VULKAN_RESET_COMMAND)
+  LVE_VULKAN_INSTANCE_COMMANDS(LVE_VULKAN_RESET_COMMAND)
+  LVE_VULKAN_DEVICE_COMMANDS(LVE_VULKAN_RESET_COMMAND)
+#undef LVE_VULKAN_RESET_COMMAND
+  vkGetInstanceProcAddr = nullptr;
+  dlclose(library);
+  library = nullptr;
+}
+
+}  // namespace lve
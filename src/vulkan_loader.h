@@ -0,0 +1,159 @@
+#pragma once
+
+// The Vulkan headers are only ever included through this one, without
+// prototypes: every vk* command below is a function pointer the loader fills
+// in, so there is no link-time dependency on libvulkan.
+#ifndef VK_NO_PROTOTYPES
+#define VK_NO_PROTOTYPES
+#endif
+#include <vulkan/vulkan.h>
+
+// commands resolved before an instance exists
+#define LVE_VULKAN_GLOBAL_COMMANDS(X)       \
+  X(vkCreateInstance)                       \
+  X(vkEnumerateInstanceExtensionProperties) \
+  X(vkEnumerateInstanceLayerProperties)
+
+// commands resolved with vkGetInstanceProcAddr
+#define LVE_VULKAN_INSTANCE_COMMANDS(X)        \
+  X(vkDestroyInstance)                         \
+  X(vkEnumeratePhysicalDevices)                \
+  X(vkEnumerateDeviceExtensionProperties)      \
+  X(vkGetPhysicalDeviceFeatures)               \
+  X(vkGetPhysicalDeviceFeatures2)              \
+  X(vkGetPhysicalDeviceFormatProperties)       \
+  X(vkGetPhysicalDeviceMemoryProperties)       \
+  X(vkGetPhysicalDeviceMemoryProperties2)      \
+  X(vkGetPhysicalDeviceProperties)             \
+  X(vkGetPhysicalDeviceProperties2)            \
+  X(vkGetPhysicalDeviceQueueFamilyProperties)  \
+  X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+  X(vkGetPhysicalDeviceSurfaceFormatsKHR)      \
+  X(vkGetPhysicalDeviceSurfacePresentModesKHR) \
+  X(vkGetPhysicalDeviceSurfaceSupportKHR)      \
+  X(vkDestroySurfaceKHR)                       \
+  X(vkCreateDevice)                            \
+  X(vkGetDeviceProcAddr)                       \
+  X(vkCreateDebugUtilsMessengerEXT)            \
+  X(vkDestroyDebugUtilsMessengerEXT)
+
+// Commands resolved with vkGetDeviceProcAddr, which go straight to the
+// driver. Core and extension variants are both listed; those the device does
+// not support stay null.
+#define LVE_VULKAN_DEVICE_COMMANDS(X) \
+  X(vkDestroyDevice)                  \
+  X(vkDeviceWaitIdle)                 \
+  X(vkGetDeviceQueue)                 \
+  X(vkQueueSubmit)                    \
+  X(vkQueueWaitIdle)                  \
+  X(vkQueuePresentKHR)                \
+  X(vkCreateSwapchainKHR)             \
+  X(vkDestroySwapchainKHR)            \
+  X(vkGetSwapchainImagesKHR)          \
+  X(vkAcquireNextImageKHR)            \
+  X(vkAllocateMemory)                 \
+  X(vkFreeMemory)                     \
+  X(vkMapMemory)                      \
+  X(vkUnmapMemory)                    \
+  X(vkCreateBuffer)                   \
+  X(vkDestroyBuffer)                  \
+  X(vkGetBufferMemoryRequirements)    \
+  X(vkBindBufferMemory)               \
+  X(vkCreateImage)                    \
+  X(vkDestroyImage)                   \
+  X(vkGetImageMemoryRequirements)     \
+  X(vkBindImageMemory)                \
+  X(vkCreateImageView)                \
+  X(vkDestroyImageView)               \
+  X(vkCreateSampler)                  \
+  X(vkDestroySampler)                 \
+  X(vkCreateFence)                    \
+  X(vkDestroyFence)                   \
+  X(vkGetFenceStatus)                 \
+  X(vkResetFences)                    \
+  X(vkWaitForFences)                  \
+  X(vkCreateSemaphore)                \
+  X(vkDestroySemaphore)               \
+  X(vkCreateQueryPool)                \
+  X(vkDestroyQueryPool)               \
+  X(vkGetQueryPoolResults)            \
+  X(vkCreateShaderModule)             \
+  X(vkDestroyShaderModule)            \
+  X(vkCreateGraphicsPipelines)        \
+  X(vkCreateComputePipelines)         \
+  X(vkDestroyPipeline)                \
+  X(vkCreatePipelineLayout)           \
+  X(vkDestroyPipelineLayout)          \
+  X(vkCreateDescriptorSetLayout)      \
+  X(vkDestroyDescriptorSetLayout)     \
+  X(vkCreateDescriptorPool)           \
+  X(vkDestroyDescriptorPool)          \
+  X(vkResetDescriptorPool)            \
+  X(vkAllocateDescriptorSets)         \
+  X(vkUpdateDescriptorSets)           \
+  X(vkCreateRenderPass)               \
+  X(vkDestroyRenderPass)              \
+  X(vkCreateFramebuffer)              \
+  X(vkDestroyFramebuffer)             \
+  X(vkCreateCommandPool)              \
+  X(vkDestroyCommandPool)             \
+  X(vkAllocateCommandBuffers)         \
+  X(vkFreeCommandBuffers)             \
+  X(vkBeginCommandBuffer)             \
+  X(vkEndCommandBuffer)               \
+  X(vkCmdBeginRenderPass)             \
+  X(vkCmdNextSubpass)                 \
+  X(vkCmdEndRenderPass)               \
+  X(vkCmdBeginRendering)              \
+  X(vkCmdBeginRenderingKHR)           \
+  X(vkCmdEndRendering)                \
+  X(vkCmdEndRenderingKHR)             \
+  X(vkCmdBindPipeline)                \
+  X(vkCmdBindDescriptorSets)          \
+  X(vkCmdBindVertexBuffers)           \
+  X(vkCmdPushConstants)               \
+  X(vkCmdSetViewport)                 \
+  X(vkCmdSetScissor)                  \
+  X(vkCmdSetCullMode)                 \
+  X(vkCmdSetCullModeEXT)              \
+  X(vkCmdSetFrontFace)                \
+  X(vkCmdSetFrontFaceEXT)             \
+  X(vkCmdSetPrimitiveTopology)        \
+  X(vkCmdSetPrimitiveTopologyEXT)     \
+  X(vkCmdSetDepthTestEnable)          \
+  X(vkCmdSetDepthTestEnableEXT)       \
+  X(vkCmdSetDepthWriteEnable)         \
+  X(vkCmdSetDepthWriteEnableEXT)      \
+  X(vkCmdSetDepthCompareOp)           \
+  X(vkCmdSetDepthCompareOpEXT)        \
+  X(vkCmdDraw)                        \
+  X(vkCmdDispatch)                    \
+  X(vkCmdPipelineBarrier)             \
+  X(vkCmdCopyBuffer)                  \
+  X(vkCmdCopyBufferToImage)           \
+  X(vkCmdCopyImageToBuffer)           \
+  X(vkCmdBlitImage)                   \
+  X(vkCmdResetQueryPool)              \
+  X(vkCmdWriteTimestamp)
+
+#define LVE_VULKAN_DECLARE_COMMAND(name) extern PFN_##name name;
+extern PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+LVE_VULKAN_GLOBAL_COMMANDS(LVE_VULKAN_DECLARE_COMMAND)
+LVE_VULKAN_INSTANCE_COMMANDS(LVE_VULKAN_DECLARE_COMMAND)
+LVE_VULKAN_DEVICE_COMMANDS(LVE_VULKAN_DECLARE_COMMAND)
+#undef LVE_VULKAN_DECLARE_COMMAND
+
+namespace lve {
+
+// Opens the Vulkan loader library and resolves vkGetInstanceProcAddr and the
+// global commands; call before anything else uses Vulkan.
+void loadVulkanLibrary();
+void loadInstanceCommands(VkInstance instance);
+// Resolves the device commands for one device, bypassing the loader's
+// dispatch trampolines. There is a single set of commands, so only one
+// device can be in use at a time.
+void loadDeviceCommands(VkDevice device);
+// once nothing uses Vulkan anymore
+void unloadVulkanLibrary();
+
+}  // namespace lve
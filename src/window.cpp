@@ -22,12 +22,20 @@ void Window::initWindow() {
   window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
   glfwSetWindowUserPointer(window, this);
   glfwSetFramebufferSizeCallback(window, framerBufferResizeCallback);
+  glfwSetWindowRefreshCallback(window, refreshCallback);
+  glfwSetKeyCallback(window, keyCallback);
+  glfwSetCursorPosCallback(window, cursorPosCallback);
+  glfwSetMouseButtonCallback(window, mouseButtonCallback);
+  glfwSetScrollCallback(window, scrollCallback);
+  glfwSetWindowFocusCallback(window, focusCallback);
 }
 
 bool Window::shouldClose() const { return glfwWindowShouldClose(window); }
 
-void Window::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface) {
-  if (glfwCreateWindowSurface(instance, window, nullptr, surface) !=
+void Window::createWindowSurface(VkInstance instance,
+                                 const VkAllocationCallbacks* allocator,
+                                 VkSurfaceKHR* surface) {
+  if (glfwCreateWindowSurface(instance, window, allocator, surface) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create window surface");
   }
@@ -38,8 +46,40 @@ void Window::framerBufferResizeCallback(GLFWwindow* window,
                                         int height) {
   auto mWindow = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
   mWindow->framebufferResized = true;
+  mWindow->redrawRequested = true;
   mWindow->width = width;
   mWindow->height = height;
 }
 
+void Window::refreshCallback(GLFWwindow* window) { requestRedraw(window); }
+
+void Window::keyCallback(
+    GLFWwindow* window, int key, int scancode, int action, int mods) {
+  requestRedraw(window);
+}
+
+void Window::cursorPosCallback(GLFWwindow* window, double x, double y) {
+  requestRedraw(window);
+}
+
+void Window::mouseButtonCallback(GLFWwindow* window,
+                                 int button,
+                                 int action,
+                                 int mods) {
+  requestRedraw(window);
+}
+
+void Window::scrollCallback(GLFWwindow* window, double x, double y) {
+  requestRedraw(window);
+}
+
+void Window::focusCallback(GLFWwindow* window, int focused) {
+  requestRedraw(window);
+}
+
+void Window::requestRedraw(GLFWwindow* window) {
+  auto mWindow = reinterpret_cast<Window*>(glfwGetWindowUserPointer(window));
+  mWindow->redrawRequested = true;
+}
+
 }  // namespace lve
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "vulkan_loader.h"
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
@@ -21,11 +23,22 @@ class Window {
 
   void resetWindowResizedFlag() { framebufferResized = false; }
 
+  // set by input and window events, which may change what should be shown
+  bool isRedrawRequested() { return redrawRequested; }
+
+  void resetRedrawRequestedFlag() { redrawRequested = false; }
+
+  bool isKeyPressed(int key) const {
+    return glfwGetKey(window, key) == GLFW_PRESS;
+  }
+
   VkExtent2D getExtent() {
     return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
   }
 
-  void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
+  void createWindowSurface(VkInstance instance,
+                           const VkAllocationCallbacks* allocator,
+                           VkSurfaceKHR* surface);
 
  private:
   void initWindow();
@@ -33,10 +46,22 @@ class Window {
   static void framerBufferResizeCallback(GLFWwindow* window,
                                          int width,
                                          int height);
+  static void refreshCallback(GLFWwindow* window);
+  static void keyCallback(
+      GLFWwindow* window, int key, int scancode, int action, int mods);
+  static void cursorPosCallback(GLFWwindow* window, double x, double y);
+  static void mouseButtonCallback(GLFWwindow* window,
+                                  int button,
+                                  int action,
+                                  int mods);
+  static void scrollCallback(GLFWwindow* window, double x, double y);
+  static void focusCallback(GLFWwindow* window, int focused);
+  static void requestRedraw(GLFWwindow* window);
 
   int width;
   int height;
   bool framebufferResized = false;
+  bool redrawRequested = true;
 
   std::string title;
   GLFWwindow* window;